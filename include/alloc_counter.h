@@ -0,0 +1,10 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+// Heap allocations made by the calling thread through operator new, for checking that steady-state frames allocate
+// nothing. Counting needs a build with YOLO_COUNT_ALLOCATIONS, which replaces the global operator new for the whole
+// process; otherwise allocation_counting() is false and the count stays at 0.
+bool allocation_counting();
+unsigned long long thread_allocation_count();
+
+#endif
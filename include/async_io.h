@@ -0,0 +1,64 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Background file reads and writes for batch runs. With liburing (YOLO_HAVE_LIBURING) one thread keeps up to depth
+// opens, reads and writes in flight on an io_uring, which hides most of the per-file latency of network storage.
+// Without it, or when the kernel lacks io_uring (before Linux 5.6, or blocked by a seccomp profile), depth threads
+// make the same calls with blocking I/O.
+
+struct FileData {
+    size_t index = 0;                   // Position in the path list
+    std::vector<unsigned char> bytes;
+    int error = 0;                      // errno of the failed open or read, 0 on success
+};
+
+// Reads a list of files ahead of the threads that decode them.
+class FilePrefetcher {
+public:
+    FilePrefetcher();
+    ~FilePrefetcher();
+    FilePrefetcher(const FilePrefetcher&) = delete;
+    FilePrefetcher& operator=(const FilePrefetcher&) = delete;
+
+    // Starts reading paths in order, with at most depth files in flight or read and not yet taken. paths must outlive
+    // the prefetcher.
+    void start(const std::vector<std::string>& paths, int depth);
+    // Blocks for the next file read, in completion order; false once every file has been taken or after stop().
+    // Safe to call from several threads.
+    bool next(FileData& file);
+    // Stops issuing reads and drops files not yet taken.
+    void stop();
+    bool uses_io_uring() const;
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+// Writes whole files in the background.
+class FileWriter {
+public:
+    FileWriter();
+    ~FileWriter();
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    // At most depth writes are queued or in flight at a time.
+    void start(int depth);
+    // Creates or truncates path and writes bytes to it; returns at once unless depth writes are outstanding. Safe to
+    // call from several threads.
+    void write(const std::string& path, std::vector<unsigned char> bytes);
+    // Waits for every outstanding write and returns how many failed.
+    size_t finish();
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+#endif
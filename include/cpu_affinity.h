@@ -0,0 +1,36 @@
+#ifndef CPU_AFFINITY_H
+#define CPU_AFFINITY_H
+
+#include <vector>
+
+// CPU ids the calling thread may run on.
+std::vector<int> thread_cpus();
+
+// Restricts the calling thread to cpus. Threads it starts afterwards inherit the set. Returns false when cpus is
+// empty, names no CPU of this machine or the OS refuses (always false outside Linux).
+bool pin_thread(const std::vector<int>& cpus);
+
+// Pins the calling thread to cpus for its lifetime and then restores the previous set. An empty cpus leaves the
+// thread alone.
+class ScopedAffinity {
+public:
+    explicit ScopedAffinity(const std::vector<int>& cpus);
+    ~ScopedAffinity();
+    ScopedAffinity(const ScopedAffinity&) = delete;
+    ScopedAffinity& operator=(const ScopedAffinity&) = delete;
+
+private:
+    std::vector<int> previous_;
+    bool pinned_ = false;
+};
+
+// NUMA nodes that have CPUs, in order. Empty without libnuma (YOLO_HAVE_LIBNUMA) or when the kernel has no NUMA
+// support.
+std::vector<int> numa_nodes();
+
+// Runs the calling thread on node's CPUs only and takes its later allocations from node's memory, so the pages it
+// touches first (model weights, buffers) are node-local. Threads it starts afterwards inherit the CPUs. Returns false
+// without libnuma.
+bool bind_thread_to_node(int node);
+
+#endif
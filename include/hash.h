@@ -0,0 +1,20 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Fast non-cryptographic 64-bit hash for cache keys: XXH3 when built against libxxhash (YOLO_HAVE_XXHASH), otherwise
+// the bundled XXH64. The two give different values, so keys kept outside the process (the persistent cache file,
+// shared between builds and restarts) must record which one made them.
+uint64_t hash64(const void* data, size_t length, uint64_t seed = 0);
+
+enum HashKind : uint32_t {
+    HASH_XXH64 = 1,
+    HASH_XXH3 = 2,
+};
+
+// The hash64 this build uses.
+HashKind hash64_kind();
+
+#endif
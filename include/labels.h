@@ -0,0 +1,43 @@
+#ifndef LABELS_H
+#define LABELS_H
+
+#include <array>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// COCO class names indexed by the class_id the model outputs.
+extern const char* const COCO_CLASSES[80];
+
+// Embedded 5x7 font pre-rasterised into RGB cells so drawing a label is just row copies.
+struct GlyphAtlas {
+    int scale = 0;
+    int cell_width = 0;                 // Pixels per glyph cell including spacing
+    int cell_height = 0;                // Pixels per glyph cell including padding
+    std::vector<unsigned char> pixels;  // Glyph g occupies rows [g * cell_height, (g + 1) * cell_height)
+};
+
+// Label atlases for every supported scale, built once when the model is loaded.
+struct LabelRenderer {
+    std::vector<GlyphAtlas> atlases;
+};
+
+void build_glyph_atlas(GlyphAtlas& atlas, int scale, const std::array<unsigned char, 3>& foreground, const std::array<unsigned char, 3>& background);
+void build_label_renderer(LabelRenderer& renderer);
+
+// Picks the atlas whose text height suits an image of the given height.
+const GlyphAtlas& select_atlas(const LabelRenderer& renderer, int image_height);
+
+// Formats "name score" (e.g. "person 0.87") into buffer, returning the number of characters written.
+int format_label(char* buffer, int buffer_size, int class_id, float score);
+
+// Blits text with its top-left corner at (x, y), clipping against the image bounds.
+void draw_text(const GlyphAtlas& atlas, unsigned char* image_data, int width, int height, int x, int y, const char* text, int length);
+
+// Draws a "name score" label above each box (or just inside it when the box touches the top edge).
+void draw_labels(unsigned char* image_data, int width, int height, const LabelRenderer& renderer, const std::vector<std::tuple<std::array<float, 4>, float, int>>& nms_boxes);
+
+// As draw_labels, for rows [band_top, band_top + band_rows) of a width x height image; band points at row band_top.
+void draw_labels_band(unsigned char* band, int width, int height, int band_top, int band_rows, const LabelRenderer& renderer, const std::vector<std::tuple<std::array<float, 4>, float, int>>& nms_boxes);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef MOTION_GATE_H
+#define MOTION_GATE_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Buffers gray_thumbnail reuses across calls, so a warm caller makes no heap allocations.
+struct ThumbnailScratch {
+    std::vector<int> column_block;
+    std::vector<uint32_t> column_count;
+    std::vector<uint32_t> sums;
+};
+
+// Block-averaged BT.601 luma of a size x size RGB image, n x n (n <= size).
+void gray_thumbnail(const unsigned char* rgb, int size, int n, uint8_t* out, ThumbnailScratch& scratch);
+
+// Cheap change detector run on the resized model input before the forward pass. The 640x640 RGB image is reduced to
+// an 80x80 grayscale thumbnail and compared, in 8x8 blocks, against a slowly adapting background using SSE2
+// sum-of-absolute-differences. A frame is static when no block changed by more than the threshold.
+class MotionGate {
+public:
+    static const int thumbnail_size = 80;
+    static const int block_size = 8;
+
+    // threshold is the mean absolute grey level difference per pixel (0-255) a block must exceed to count as motion.
+    // It is atomic so callers can check whether the gate is on without taking the lock that guards the background.
+    void set_threshold(float threshold) { threshold_ = threshold; }
+    float threshold() const { return threshold_; }
+
+    // True when the size x size RGB image shows no change against the background. The image is folded into the
+    // background either way, so slow lighting changes and objects that stop moving are absorbed over time.
+    bool is_static(const unsigned char* rgb, int size);
+    void reset() { background_.clear(); }
+
+private:
+    std::atomic<float> threshold_{0.0f};
+    std::vector<uint8_t> thumbnail_;
+    ThumbnailScratch scratch_;
+    std::vector<uint8_t> background_;       // Background grey levels compared against
+    std::vector<uint16_t> background_q8_;   // The same with 8 fractional bits, for the running average
+};
+
+#endif
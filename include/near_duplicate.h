@@ -0,0 +1,71 @@
+#ifndef NEAR_DUPLICATE_H
+#define NEAR_DUPLICATE_H
+
+#include "motion_gate.h"
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+// Cache of detections for re-encoded, resized or lightly edited copies of images already processed. Images are keyed
+// by a 64-bit DCT perceptual hash of the resized model input and looked up in a BK-tree by Hamming distance.
+// Detections are kept in model input coordinates, which are relative to the image size, so they apply unchanged to a
+// copy at any resolution.
+
+// pHash of a size x size RGB image: the 8x8 lowest frequencies of the DCT of a 32x32 grayscale thumbnail, one bit per
+// coefficient set when it is above the median. The thumbnail's buffers come from scratch.
+uint64_t perceptual_hash(const unsigned char* rgb, int size, ThumbnailScratch& scratch);
+
+class NearDuplicateCache {
+public:
+    // max_entries of 0 disables the cache. Lookups visit at most max_visits tree nodes, which bounds their cost
+    // (roughly 70 ns per node) at the price of occasionally missing a match in a very large cache; 0 means 2048.
+    void configure(size_t max_entries, int max_distance, int max_visits);
+    bool enabled() const { return max_entries_ != 0; }
+
+    // Closest entry for the model within max_distance bits, if any. stack is the caller's search stack, kept between
+    // lookups so they do not allocate.
+    bool lookup(uint64_t hash, uint64_t model_id, std::vector<std::tuple<std::array<float, 4>, float, int>>& detections, std::vector<int>& stack);
+    void insert(uint64_t hash, uint64_t model_id, const std::vector<std::tuple<std::array<float, 4>, float, int>>& detections);
+
+    struct Stats {
+        unsigned long long hits = 0;
+        unsigned long long misses = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+    Stats stats();
+
+private:
+    struct Entry {
+        uint64_t hash = 0;
+        uint64_t model_id = 0;
+        bool live = false;
+        int node = -1;      // BK-tree node holding this entry
+        std::vector<std::tuple<std::array<float, 4>, float, int>> detections;
+    };
+
+    // BK-tree node: children are keyed by their Hamming distance to this node's hash.
+    struct Node {
+        uint64_t hash;
+        int entry;          // Index into entries_, -1 once the entry has been overwritten
+        std::vector<std::pair<int, int>> children;  // (distance, node index)
+    };
+
+    int add_node(uint64_t hash, int entry);
+    void rebuild();
+
+    std::mutex mutex_;
+    size_t max_entries_ = 0;
+    int max_distance_ = 6;
+    int max_visits_ = 2048;
+    std::vector<Entry> entries_;    // Ring buffer; the oldest entry is overwritten when full
+    size_t next_entry_ = 0;
+    std::vector<Node> nodes_;
+    size_t dead_nodes_ = 0;
+    unsigned long long hits_ = 0;
+    unsigned long long misses_ = 0;
+};
+
+#endif
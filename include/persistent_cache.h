@@ -0,0 +1,55 @@
+#ifndef PERSISTENT_CACHE_H
+#define PERSISTENT_CACHE_H
+
+#include "result_cache.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Detection cache in a memory-mapped file, shared by every process that opens the same path and kept across restarts.
+// The file is a fixed-capacity open-addressing table: a key lives in one of probe_length slots after its home slot,
+// and when all of them are taken the clock algorithm picks the victim among them. Slots are guarded by a sequence
+// counter (a seqlock) so readers never block, and writers claim a slot with a compare-and-swap on that counter, so any
+// number of processes can read and insert at once without a lock. A process killed in the middle of an insert leaves
+// that one slot unusable until the file is recreated.
+class PersistentCache {
+public:
+    static const int probe_length = 16;
+
+    PersistentCache() = default;
+    ~PersistentCache();
+    PersistentCache(const PersistentCache&) = delete;
+    PersistentCache& operator=(const PersistentCache&) = delete;
+
+    // Opens or creates the cache file. A new file gets capacity slots (rounded up to a power of two) of up to
+    // max_detections detections each; an existing file keeps its own geometry and capacity/max_detections are ignored.
+    bool open(const char* path, size_t capacity, int max_detections);
+
+    bool lookup(const ResultCacheKey& key, std::vector<std::tuple<std::array<float, 4>, float, int>>& detections);
+    // Results with more than max_detections detections are not stored.
+    void insert(const ResultCacheKey& key, const std::vector<std::tuple<std::array<float, 4>, float, int>>& detections);
+
+    struct Stats {
+        unsigned long long hits = 0;     // This process only
+        unsigned long long misses = 0;
+        size_t entries = 0;
+        size_t bytes = 0;                // File size
+    };
+    Stats stats() const;
+
+private:
+    struct Header;
+    struct Slot;
+
+    Slot* slot(uint64_t index) const;
+
+    int fd_ = -1;
+    void* map_ = nullptr;
+    size_t map_size_ = 0;
+    Header* header_ = nullptr;
+    std::atomic<unsigned long long> hits_{0};
+    std::atomic<unsigned long long> misses_{0};
+};
+
+#endif
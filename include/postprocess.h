@@ -0,0 +1,61 @@
+#ifndef POSTPROCESS_H
+#define POSTPROCESS_H
+
+#include <array>
+#include <vector>
+
+// Decode and NMS shared by process_frame and the yolo::decode_nms TorchScript operator.
+// Predictions are one image's raw [4 + classes, anchors] block (centre x, y, w, h rows then class scores);
+// boxes come out as top-left (x, y, w, h) in model input pixels.
+
+// Detections travel from decode to the caches, the tracker and the drawing code in the pixels of a reference_size
+// square model input, whatever input size the request actually ran at.
+const int reference_size = 640;
+
+// IoU used for NMS
+float iou(const std::array<float, 4>& box1, const std::array<float, 4>& box2);
+
+// Candidates NMS looks at by default. Only a few hundred boxes ever survive NMS, so in crowded scenes with low
+// thresholds the rest are just sorting and IoU work.
+const int default_max_candidates = 1000;
+
+// Fills order with the indices of the max_candidates highest scores (all of them when max_candidates is 0 or larger
+// than the list), best first. Selects with nth_element and sorts only the selected part.
+void select_top_candidates(const std::vector<float>& scores, int max_candidates, std::vector<int>& order);
+
+// NMS function to filter model outputs. max_candidates limits the boxes considered as above (0 considers all).
+std::vector<int> apply_nms(
+    const std::vector<std::array<float, 4>>& boxes,
+    const std::vector<float>& scores,
+    const std::vector<int>& class_ids,
+    float score_threshold, float nms_threshold, int max_candidates = 0
+);
+
+// As above with caller-owned buffers (score order, suppression flags, kept indices), which keep their capacity from
+// call to call so a steady stream of frames does not allocate.
+void apply_nms(
+    const std::vector<std::array<float, 4>>& boxes,
+    const std::vector<float>& scores,
+    const std::vector<int>& class_ids,
+    float score_threshold, float nms_threshold, int max_candidates,
+    std::vector<int>& order, std::vector<unsigned char>& suppressed, std::vector<int>& keep
+);
+
+// Highest scoring class per anchor for anchors [begin, end); best_scores/best_classes are indexed by anchor.
+void find_best_classes(const float* predictions, int channels, int anchors, int begin, int end, float* best_scores, int* best_classes);
+
+// As find_best_classes, scanning only the listed classes (ids outside the model's classes are ignored). Anchors get a
+// score of -infinity and class -1 when no listed class is valid.
+void find_best_allowed_classes(
+    const float* predictions, int channels, int anchors, int begin, int end,
+    const int* classes, int class_count, float* best_scores, int* best_classes
+);
+
+// Appends anchors in [begin, end) whose best class score is at least score_threshold.
+void collect_candidates(
+    const float* predictions, int anchors, int begin, int end,
+    const float* best_scores, const int* best_classes, float score_threshold,
+    std::vector<std::array<float, 4>>& boxes, std::vector<float>& scores, std::vector<int>& class_ids
+);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// In-process LRU cache of detection results, so re-uploads of the same image skip decode and inference. Entries are
+// keyed by a hash of the encoded file plus the model and the request options that affect the result.
+
+struct ResultCacheKey {
+    uint64_t content = 0;   // hash64 of the encoded image bytes
+    uint64_t model = 0;     // YOLOv8::model_id
+    uint64_t options = 0;   // Processing mode and its parameters
+
+    bool operator==(const ResultCacheKey& other) const {
+        return content == other.content && model == other.model && options == other.options;
+    }
+};
+
+struct ResultCacheKeyHash {
+    size_t operator()(const ResultCacheKey& key) const {
+        return static_cast<size_t>(key.content ^ (key.model * 0x9E3779B97F4A7C15ULL) ^ (key.options * 0xC2B2AE3D27D4EB4FULL));
+    }
+};
+
+struct CachedResult {
+    std::vector<std::tuple<std::array<float, 4>, float, int>> detections;   // Model input coordinates
+    std::vector<unsigned char> output;                                      // Encoded annotated image, if stored
+};
+
+class ResultCache {
+public:
+    // max_bytes of 0 disables the cache and drops every entry.
+    void configure(size_t max_bytes, bool store_output);
+    bool enabled() const { return max_bytes_ != 0; }
+    bool stores_output() const { return store_output_; }
+
+    bool lookup(const ResultCacheKey& key, CachedResult& result);
+    void insert(const ResultCacheKey& key, CachedResult result);
+
+    struct Stats {
+        unsigned long long hits = 0;
+        unsigned long long misses = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+    Stats stats();
+
+private:
+    struct Entry {
+        ResultCacheKey key;
+        CachedResult result;
+        size_t bytes;
+    };
+
+    void evict_to(size_t max_bytes);
+
+    std::mutex mutex_;
+    size_t max_bytes_ = 0;
+    bool store_output_ = false;
+    size_t bytes_ = 0;
+    unsigned long long hits_ = 0;
+    unsigned long long misses_ = 0;
+    std::list<Entry> entries_;  // Most recently used first
+    std::unordered_map<ResultCacheKey, std::list<Entry>::iterator, ResultCacheKeyHash> index_;
+};
+
+#endif
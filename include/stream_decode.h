@@ -0,0 +1,75 @@
+#ifndef STREAM_DECODE_H
+#define STREAM_DECODE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+// Row-at-a-time image decoding and encoding so very large inputs never have to be held in memory as a whole.
+
+// Decodes an image top to bottom as packed RGB rows.
+class RowReader {
+public:
+    virtual ~RowReader() = default;
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // Decodes the next row into rgb (width() * 3 bytes). Returns false on a decode error or past the last row.
+    virtual bool read_row(unsigned char* rgb) = 0;
+
+protected:
+    int width_ = 0;
+    int height_ = 0;
+};
+
+// Opens a JPEG (libjpeg) or non-interlaced PNG (libpng) for row reading; nullptr for other formats, interlaced PNGs,
+// or when the library was built without the matching decoder. For JPEGs, scale_denom of 2, 4 or 8 lets libjpeg
+// decode straight to 1/2, 1/4 or 1/8 size in the DCT domain, which is much cheaper than decoding full size.
+std::unique_ptr<RowReader> open_row_reader(const char* path, int scale_denom = 1);
+
+// Largest JPEG DCT scale denominator (1, 2, 4 or 8) that keeps a width x height image at least min_width x min_height.
+int jpeg_scale_denom(int width, int height, int min_width, int min_height);
+
+// Area-averaging downscaler fed one source row at a time; holds only one accumulator row plus the output.
+class StreamingDownscaler {
+public:
+    StreamingDownscaler(int src_width, int src_height, int dst_width, int dst_height);
+
+    void push_row(const unsigned char* rgb);
+    const std::vector<unsigned char>& result() const { return output_; }
+    std::vector<unsigned char> release() { return std::move(output_); }
+    int width() const { return dst_width_; }
+    int height() const { return dst_height_; }
+
+private:
+    void flush_row();
+
+    int src_width_, src_height_, dst_width_, dst_height_;
+    int src_row_ = 0;
+    int dst_row_ = 0;
+    int rows_accumulated_ = 0;
+    std::vector<int> column_map_;           // Destination column for each source column
+    std::vector<int> column_counts_;        // Source columns averaged into each destination column
+    std::vector<uint32_t> accumulator_;     // Per destination pixel channel sums for the current destination row
+    std::vector<unsigned char> output_;
+};
+
+// Writes a baseline JPEG one row at a time (libjpeg).
+class JpegRowWriter {
+public:
+    JpegRowWriter();
+    ~JpegRowWriter();
+    JpegRowWriter(const JpegRowWriter&) = delete;
+    JpegRowWriter& operator=(const JpegRowWriter&) = delete;
+
+    bool open(const char* path, int width, int height, int quality);
+    bool write_row(const unsigned char* rgb);
+    bool close();
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef TRACKER_H
+#define TRACKER_H
+
+#include <array>
+#include <tuple>
+#include <vector>
+
+// ByteTrack-style multi-object tracker for process_video. Each track carries a constant-velocity Kalman filter over
+// its box centre and size, so it can be propagated across frames where the detector does not run. Boxes are
+// top-left (x, y, w, h) in the same coordinates as the detections fed to update().
+
+struct TrackerOptions {
+    float high_threshold = 0.5f;    // Detections at or above this score are matched first and may start new tracks
+    float match_iou = 0.3f;         // Minimum IoU between a predicted track and a detection to associate them
+    int max_lost_frames = 30;       // Frames an unmatched track is kept for re-association before it is dropped
+    float confidence_decay = 0.95f; // Per-frame decay of a track's confidence while it is only predicted
+};
+
+// Kalman state for one box coordinate: position and velocity with their 2x2 covariance. With a constant-velocity
+// model and diagonal noise the four coordinates are independent, so each is filtered on its own.
+struct KalmanAxis {
+    float position = 0.0f;
+    float velocity = 0.0f;
+    float p00 = 0.0f, p01 = 0.0f, p11 = 0.0f;
+};
+
+struct Track {
+    int id = 0;
+    int class_id = 0;
+    float score = 0.0f;             // Score of the last matched detection
+    float confidence = 0.0f;        // score, decayed for every frame since the last match
+    int hits = 0;                   // Detections matched over the track's lifetime
+    int frames_since_update = 0;
+    bool lost = false;              // Unmatched at the last detector run
+    KalmanAxis axes[4];             // Centre x, centre y, width, height
+
+    std::array<float, 4> box() const;
+};
+
+class Tracker {
+public:
+    explicit Tracker(const TrackerOptions& options = TrackerOptions());
+
+    // Advances every track by one frame.
+    void predict();
+    // Associates a detector run's detections (box, score, class_id) with the predicted tracks: high scoring
+    // detections first, then the remaining low scoring ones against tracks still unmatched. Unmatched high scoring
+    // detections start new tracks.
+    void update(const std::vector<std::tuple<std::array<float, 4>, float, int>>& detections);
+
+    // Tracks matched at the last detector run (lost tracks are kept internally but not reported).
+    std::vector<const Track*> active_tracks() const;
+    // Lowest confidence over the active tracks, 1 when there are none.
+    float min_confidence() const;
+
+private:
+    void match(const std::vector<std::tuple<std::array<float, 4>, float, int>>& detections, const std::vector<int>& candidates,
+               std::vector<bool>& track_matched, std::vector<bool>& detection_matched);
+
+    TrackerOptions options_;
+    std::vector<Track> tracks_;
+    int next_id_ = 1;
+};
+
+#endif
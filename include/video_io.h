@@ -0,0 +1,61 @@
+#ifndef VIDEO_IO_H
+#define VIDEO_IO_H
+
+#include <memory>
+#include <vector>
+
+// Video decoding on a background thread into a ring of preallocated RGB frames, and video encoding, through
+// libavformat/libavcodec (YOLO_WITH_FFMPEG).
+
+struct VideoFrame {
+    long long index = 0;                        // Position in the stream, from 0
+    double timestamp_ms = 0.0;                  // Presentation time
+    bool has_model_input = false;               // Set on every frame_stride'th frame
+    std::vector<unsigned char> model_input;     // model_width x model_height RGB
+    std::vector<unsigned char> rgb;             // Full-resolution RGB, only when opened with full_frames
+};
+
+class VideoReader {
+public:
+    VideoReader();
+    ~VideoReader();
+    VideoReader(const VideoReader&) = delete;
+    VideoReader& operator=(const VideoReader&) = delete;
+
+    // Opens the first video stream and starts the decode thread. ring_size frames are allocated up front and the
+    // decoder runs ahead of the caller by at most that many. Every frame is decoded (later frames depend on it), but
+    // only every frame_stride'th one is scaled to the model input.
+    bool open(const char* path, int model_width, int model_height, int ring_size, int frame_stride, bool full_frames);
+    int width() const;
+    int height() const;
+    double frame_rate() const;
+
+    // Blocks for the next decoded frame; nullptr at the end of the stream or after a decode error.
+    VideoFrame* next();
+    // Returns a frame obtained from next() to the ring.
+    void release(VideoFrame* frame);
+    bool failed() const;
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+// Encodes RGB frames with the container's default video codec (chosen from the file extension).
+class VideoWriter {
+public:
+    VideoWriter();
+    ~VideoWriter();
+    VideoWriter(const VideoWriter&) = delete;
+    VideoWriter& operator=(const VideoWriter&) = delete;
+
+    bool open(const char* path, int width, int height, double frame_rate);
+    bool write(const unsigned char* rgb);
+    bool close();
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+#endif
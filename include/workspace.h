@@ -0,0 +1,87 @@
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include <array>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Reusable per-frame memory. Every buffer here only ever grows, so once a handle has seen its largest frame the
+// steady-state path from resize to NMS output makes no heap allocations.
+
+// Heap array aligned for SIMD loads. reserve() reallocates only when asked for more than ever before, and does not
+// preserve the contents when it does.
+template <typename T>
+class AlignedBuffer {
+    static_assert(std::is_trivially_copyable<T>::value, "AlignedBuffer holds plain data only");
+
+public:
+    static const size_t alignment = 64;
+
+    AlignedBuffer() = default;
+    ~AlignedBuffer() { release(); }
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    T* reserve(size_t count) {
+        if (count > capacity_) {
+            release();
+            data_ = static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(alignment)));
+            capacity_ = count;
+        }
+        return data_;
+    }
+    T* data() const { return data_; }
+    size_t capacity() const { return capacity_; }
+
+private:
+    void release() {
+        if (data_) ::operator delete(data_, std::align_val_t(alignment));
+        data_ = nullptr;
+        capacity_ = 0;
+    }
+
+    T* data_ = nullptr;
+    size_t capacity_ = 0;
+};
+
+// Bump allocator for scratch memory whose size depends on the input, such as stb_image_resize's filter buffers
+// (passed as its STBIR_MALLOC context). Allocations are freed together by reset(). Running out opens an extra block
+// rather than moving live allocations; the next reset() then merges everything into one block of the combined size.
+class ScratchArena {
+public:
+    ScratchArena() = default;
+    ~ScratchArena();
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    void* allocate(size_t size);
+    void reset();
+    size_t capacity() const;
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
+    Block current_ {nullptr, 0};
+    size_t used_ = 0;
+    std::vector<Block> retired_;    // Full blocks still holding allocations from before the last reset()
+};
+
+// Decode and NMS buffers reused across frames (see decode_output in yolov8.cpp).
+struct DecodeScratch {
+    AlignedBuffer<float> best_scores;   // One per anchor
+    AlignedBuffer<int> best_classes;
+    std::vector<std::array<float, 4>> boxes;
+    std::vector<float> scores;
+    std::vector<int> class_ids;
+    std::vector<int> allowed_channels;  // Class allow-list translated to a pruned model's output channels
+    std::vector<int> order;
+    std::vector<unsigned char> suppressed;
+    std::vector<int> keep;
+};
+
+#endif
@@ -6,10 +6,223 @@ extern "C" {
 #endif
 
 struct YOLOv8;
+
+enum YOLOv8Precision {
+    YOLO_PRECISION_FP32 = 0,
+    YOLO_PRECISION_BF16 = 1     // Falls back to FP32 when the CPU lacks AVX512-BF16/AMX-BF16
+};
+
+enum YOLOv8Backend {
+    YOLO_BACKEND_AUTO = 0,      // Chosen from the file extension: .onnx -> ONNX Runtime, otherwise TorchScript
+    YOLO_BACKEND_TORCH = 1,
+    YOLO_BACKEND_ONNXRUNTIME = 2,   // Requires building with -DYOLO_WITH_ONNXRUNTIME=ON
+    YOLO_BACKEND_OPENVINO = 3       // Requires building with -DYOLO_WITH_OPENVINO=ON
+};
+
+enum YOLOv8ReloadState {
+    YOLO_RELOAD_NONE = 0,           // No reload_model call for the name
+    YOLO_RELOAD_PENDING = 1,        // Loading and warming up; requests still run on the current model
+    YOLO_RELOAD_DONE = 2,           // The new model is serving
+    YOLO_RELOAD_FAILED = 3,         // The new model could not be loaded or run; the current model is kept
+    YOLO_RELOAD_SUPERSEDED = 4      // The name was unregistered or registered again while loading; the new model is dropped
+};
+
+struct YOLOv8LoadOptions {
+    int precision;              // YOLOv8Precision (TorchScript backend only)
+    int backend;                // YOLOv8Backend
+    int concurrency;            // Expected concurrent process_frame calls on this handle (OpenVINO streams)
+    int numa_replicas;          // register_model/reload_model: one copy per NUMA node (needs libnuma), each served by
+                                // concurrency worker threads bound to its node
+};
+
+struct YOLOv8Stats {
+    double load_ms;             // load_model wall time
+    double first_forward_ms;    // First forward, including lazy backend initialisation
+    double mean_forward_ms;     // Mean forward time over the frames after the first
+    unsigned long long frames;
+    unsigned long long skipped_frames;  // Frames the motion gate answered without a forward pass
+    long long frame_allocations;        // Heap allocations of the last in-memory process_frame detection, from the
+                                        // resize to the NMS output (motion gate and near-duplicate cache included,
+                                        // the forward pass left out); decoding, result caches, drawing and the
+                                        // streaming, tiled and video paths are not counted. 0 once the workspace is
+                                        // warm, except while the near-duplicate cache is still filling; -1 unless
+                                        // built with -DYOLO_COUNT_ALLOCATIONS=ON
+    unsigned long long weight_bytes;    // Model weights held in memory
+    unsigned long long workspace_bytes; // Frame buffers kept for reuse between calls
+};
+
+struct YOLOv8ThreadOptions {
+    int intra_op_threads;       // Threads per forward pass, 0 keeps the runtime's default (one per core)
+    int inter_op_threads;       // Threads running independent graph ops in parallel, 0 keeps the default
+    const int* inference_cpus;  // CPU ids for the inference threads, NULL to leave them unpinned
+    int inference_cpu_count;
+    const int* processing_cpus; // CPU ids for threads calling into the library, NULL to leave them unpinned
+    int processing_cpu_count;
+};
+
+// The configuration in effect, from get_thread_info.
+struct YOLOv8ThreadInfo {
+    int intra_op_threads;       // libtorch's intra-op threads
+    int inter_op_threads;
+    int available_cpus;         // CPUs the process could run on before any pinning
+    int inference_cpu_count;    // 0 when inference threads are not pinned
+    int processing_cpu_count;   // 0 when calling threads are not pinned
+};
+
+struct YOLOv8CacheStats {
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long entries;
+    unsigned long long bytes;
+    double hit_ratio;           // hits / (hits + misses)
+};
+
+enum YOLOv8OversizePolicy {
+    YOLO_OVERSIZE_REJECT = 0,       // Fail the call without decoding the image
+    YOLO_OVERSIZE_DOWNSAMPLE = 1    // Stream the image (JPEG/PNG) instead of decoding it whole
+};
+
+struct YOLOv8TileOptions {
+    int overlap;                // Pixels shared by neighbouring 640x640 tiles
+    int batch_size;             // Tiles per forward call
+};
+
+// Per-request settings for process_frame_with_options. default_options fills in the values process_frame uses.
+struct YOLOv8Options {
+    float score_threshold;      // Minimum class score (0.25)
+    float nms_threshold;        // IoU above which the lower scoring of two boxes is dropped (0.45)
+    int input_size;             // Square model input in pixels, rounded to a multiple of 32 (640). Other sizes than the
+                                // export's need a model with dynamic input shapes (modelExport.py --dynamic)
+    int max_detections;         // Highest scoring detections kept per image, 0 keeps all
+    const int* classes;         // Class ids to detect, NULL for all. Only these classes' scores are scanned per anchor
+    int class_count;
+    double latency_budget_ms;   // When > 0, run at the largest of input_size, 3/4 and 1/2 of it expected to finish
+                                // within this many ms of the call (minus time already spent); needs a dynamic-shape
+                                // model. 0 always runs at input_size
+};
+
+// One detection in source image/frame pixels.
+struct YOLOv8Detection {
+    float x, y, width, height;  // Top-left corner and size
+    float score;
+    int class_id;               // COCO class index
+    int track_id;               // Stable id across video frames when tracking, otherwise -1
+};
+
+// Filled in by process_frame_with_options.
+struct YOLOv8Result {
+    YOLOv8Detection* detections;    // Caller-owned array of capacity entries (in image pixels), or NULL
+    int capacity;
+    int count;                      // Detections in the image, which may exceed capacity
+    int input_size;                 // Model input size the request ran at (0 when answered from a cache)
+    double elapsed_ms;              // Time spent in the call
+};
+
+struct YOLOv8VideoOptions {
+    int frame_stride;           // Run the detector on every Nth frame; frames in between repeat the last detections
+    int ring_size;              // Decoded frames buffered ahead of the detector
+    const char* output_path;    // Annotated output video (container from the extension), or NULL for callbacks only
+    int track;                  // Track objects across frames; frames in between detector runs report predicted tracks
+    float min_track_confidence; // When tracking, also run the detector as soon as a track's confidence drops below this
+};
+
+// Called once per decoded frame, in order. detections is only valid during the call.
+typedef void (*YOLOv8FrameCallback)(void* user_data, long long frame_index, double timestamp_ms, const YOLOv8Detection* detections, int count);
+// Called once per image of a detect_batch call, in input order. detections is only valid during the call.
+typedef void (*YOLOv8BatchCallback)(void* user_data, int index, const YOLOv8Detection* detections, int count);
+
+void default_load_options(YOLOv8LoadOptions* options);
+void default_options(YOLOv8Options* options);
+void default_tile_options(YOLOv8TileOptions* options);
+void default_video_options(YOLOv8VideoOptions* options);
 YOLOv8* load_model(const char* model_path);
+YOLOv8* load_model_with_options(const char* model_path, const YOLOv8LoadOptions* options);
+int get_model_precision(YOLOv8* model);
+void get_model_stats(YOLOv8* model, YOLOv8Stats* stats);
+// Skips the forward pass, returning the previous detections, when a frame differs from the running background by
+// less than threshold (mean grey level difference, 0-255, in any 64x64 block of the model input). 0 disables.
+// The gate keeps one background per handle, so use one handle per camera.
+void set_motion_gate(YOLOv8* model, float threshold);
+// Process-wide LRU cache of results keyed by a hash of the input file's bytes, the model and the processing options.
+// max_bytes of 0 (the default) disables it; store_output also keeps the encoded annotated image so hits skip decoding.
+void set_result_cache(unsigned long long max_bytes, int store_output);
+void get_result_cache_stats(YOLOv8CacheStats* stats);
+// Process-wide cache of detections keyed by a 64-bit perceptual hash of the resized image, so re-encoded or resized
+// copies of an earlier upload reuse its detections (process_frame only). Matches are within max_distance differing
+// bits (4-8 is typical); each lookup visits at most max_visits entries (0 keeps the default of 2048, about 150 us).
+// max_entries of 0 (the default) disables it.
+void set_near_duplicate_cache(unsigned long long max_entries, int max_distance, int max_visits);
+void get_near_duplicate_cache_stats(YOLOv8CacheStats* stats);
+// Detection cache in a memory-mapped file, checked after the in-memory result cache. It survives restarts and is
+// shared by every process that opens the same path. A new file holds capacity entries of up to max_detections
+// detections; an existing file keeps its own size. Returns 0 when the file cannot be opened or has another format.
+int open_persistent_cache(const char* path, unsigned long long capacity, int max_detections);
+void close_persistent_cache();
+// hits and misses count this process only; bytes is the file size.
+void get_persistent_cache_stats(YOLOv8CacheStats* stats);
+void set_pixel_budget(YOLOv8* model, unsigned long long max_pixels, int policy);
+// Number of highest scoring candidates that go through NMS per image (default 1000); the rest are dropped before
+// sorting. 0 sends every candidate above the score threshold through NMS.
+void set_max_candidates(YOLOv8* model, int max_candidates);
 void process_frame(YOLOv8* model, const char* frame_path, const char* output_path);
+// process_frame with per-request options (NULL for the defaults), reporting into result when it is not NULL. Returns
+// the number of detections, or -1 on failure. output_path may be NULL to only detect.
+// Models exported with --nms have their thresholds baked in; score_threshold can only raise them there.
+int process_frame_with_options(YOLOv8* model, const char* frame_path, const char* output_path, const YOLOv8Options* options, YOLOv8Result* result);
+void process_frame_tiled(YOLOv8* model, const char* frame_path, const char* output_path, const YOLOv8TileOptions* options);
+// Returns the number of frames processed, or -1 when the video cannot be opened, a frame fails to decode or inference
+// fails.
+long long process_video(YOLOv8* model, const char* input_path, const YOLOv8VideoOptions* options, YOLOv8FrameCallback callback, void* user_data);
+// Runs count 640x640 RGB model inputs through the model in one forward pass and reports each image's detections scaled
+// to widths[i] x heights[i]. Models exported with a fixed batch of 1 run the images one at a time. Returns 0 when
+// inference fails. Unlike process_frame this skips the caches and the motion gate.
+int detect_batch(YOLOv8* model, const unsigned char* const* inputs, const int* widths, const int* heights, int count, YOLOv8BatchCallback callback, void* user_data);
+// Draws boxes and "class score" labels onto a width x height RGB image.
+void draw_detections(YOLOv8* model, unsigned char* image_data, int width, int height, const YOLOv8Detection* detections, int count);
 void release_model(YOLOv8* model);
 
+// Named models held by the library, e.g. yolov8n for interactive requests next to yolov8m for batch runs. Every
+// registered model shares libtorch's intra-op thread pool, ONNX Runtime's global thread pools and one OpenVINO core.
+// Registering a name again replaces its model once the requests already running on it finish. options may be NULL
+// for the defaults. Returns 0 when the model cannot be loaded.
+int register_model(const char* name, const char* model_path, const YOLOv8LoadOptions* options);
+// Returns 0 when no model has that name.
+int unregister_model(const char* name);
+// The named model's handle, or NULL, for the per-handle calls (set_motion_gate, process_frame_with_options, ...). The
+// handle keeps that model alive, even after the name is unregistered, registered again or reloaded, until each acquire
+// is matched by release_acquired_model (not release_model). With NUMA replicas this is the first replica; per-handle
+// settings go to each replica from acquire_replica.
+YOLOv8* acquire_model(const char* name);
+int get_replica_count(const char* name);
+YOLOv8* acquire_replica(const char* name, int index);
+// Intra-op threads of each worker of a NUMA replica (its node's CPUs over the workers per node, so nodes can differ);
+// 0 for a replica without a node or when there is no such replica.
+int get_replica_threads(const char* name, int index);
+void release_acquired_model(YOLOv8* model);
+// process_frame_with_options on the named model, on the replica with the fewest requests in flight; -1 when no model
+// has that name.
+int process_frame_named(const char* name, const char* frame_path, const char* output_path, const YOLOv8Options* options, YOLOv8Result* result);
+// get_model_stats on the named model (latency, weight and workspace memory), summed over its replicas; returns 0 when
+// no model has that name.
+int get_named_model_stats(const char* name, YOLOv8Stats* stats);
+// Loads model_path on a background thread, runs one warm-up frame through it and then swaps it in under name, keeping
+// the motion gate threshold, pixel budget and candidate limit of the model it replaces. Requests keep running on the
+// current model meanwhile and those already running finish on it before it is released. The swap is skipped when the
+// name was unregistered or registered again in the meantime. Returns 0 when a reload of that name is still pending;
+// get_reload_state reports how it went.
+int reload_model(const char* name, const char* model_path, const YOLOv8LoadOptions* options);
+int get_reload_state(const char* name);
+
+// Process-wide threading, for packing several PHP workers or library instances onto one host. Call it before loading
+// models: ONNX Runtime's pools start with the first ONNX model and OpenVINO reads the thread count at compile time.
+// Inference threads (libtorch's intra-op pool, ONNX Runtime's global pools, OpenVINO's streams) are pinned to
+// inference_cpus; threads calling into the library are moved onto processing_cpus on their next call and do the
+// decoding, resizing, NMS and drawing there. The calling thread also takes one share of each libtorch forward.
+// Returns 0 when part of it could not be applied any more (see the log).
+void default_thread_options(YOLOv8ThreadOptions* options);
+int set_thread_options(const YOLOv8ThreadOptions* options);
+void get_thread_info(YOLOv8ThreadInfo* info);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,6 +1,232 @@
 # Should be run from within the model directory.
+#
+#   python modelExport.py                                   # float TorchScript (yolov8n.torchscript)
+#   python modelExport.py --int8 --calib-dir ../calib       # INT8 TorchScript (yolov8n_int8.torchscript)
+#   python modelExport.py --onnx                            # float TorchScript and ONNX (yolov8n.onnx)
+#   python modelExport.py --openvino                        # float TorchScript and OpenVINO IR (yolov8n_openvino_model/)
+#   python modelExport.py --nms                             # TorchScript ending in yolo::decode_nms (yolov8n_nms.torchscript)
+#   python modelExport.py --classes 0,2                     # Head pruned to person and car ([1, 6, 8400] output)
+import argparse
+import json
+from pathlib import Path
+
+import cv2
+import numpy as np
+import torch
 from ultralytics import YOLO
 
-model = YOLO("yolov8n.pt") # Update with the path to desired model to convert into TorchScript.
+IMAGE_SUFFIXES = {".jpg", ".jpeg", ".png", ".bmp"}
+
+
+def load_image(path, imgsz):
+    # Matches process_frame: RGB, plain resize to imgsz x imgsz (no letterbox), scaled to [0, 1].
+    image = cv2.imread(str(path), cv2.IMREAD_COLOR)
+    image = cv2.cvtColor(image, cv2.COLOR_BGR2RGB)
+    image = cv2.resize(image, (imgsz, imgsz), interpolation=cv2.INTER_AREA)
+    return torch.from_numpy(np.ascontiguousarray(image.transpose(2, 0, 1))).float().div(255).unsqueeze(0)
+
+
+def list_images(directory, limit=None):
+    images = sorted(p for p in Path(directory).iterdir() if p.suffix.lower() in IMAGE_SUFFIXES)
+    return images[:limit] if limit else images
+
+
+def prune_classes(det_model, classes):
+    # Keeps only the listed COCO classes in the Detect head: each scale's final 1x1 classification conv is cut down to
+    # those output channels, so the head computes and the output carries 4 + len(classes) rows instead of 84. The
+    # original class ids are recorded in the export metadata ("classes") and load_model maps the channels back to them.
+    head = det_model.model[-1]
+    index = torch.tensor(classes)
+    for branch in head.cv3:
+        conv = branch[-1]
+        pruned = torch.nn.Conv2d(conv.in_channels, len(classes), conv.kernel_size, conv.stride, conv.padding, bias=conv.bias is not None)
+        with torch.no_grad():
+            pruned.weight.copy_(conv.weight[index])
+            if conv.bias is not None:
+                pruned.bias.copy_(conv.bias[index])
+        branch[-1] = pruned
+    head.nc = len(classes)
+    head.no = head.nc + head.reg_max * 4
+    det_model.nc = len(classes)
+    det_model.names = {i: det_model.names[c] for i, c in enumerate(classes)}
+    return det_model
+
+
+def tag_classes(path, classes):
+    # Records the pruned head's class ids where each backend's loader looks for metadata.
+    path = Path(path)
+    if path.suffix == ".torchscript":
+        extra_files = {"config.txt": ""}
+        module = torch.jit.load(str(path), map_location="cpu", _extra_files=extra_files)
+        config = json.loads(extra_files["config.txt"] or "{}")
+        config["classes"] = classes
+        torch.jit.save(module, str(path), _extra_files={"config.txt": json.dumps(config)})
+    elif path.suffix == ".onnx":
+        import onnx
+
+        model = onnx.load(str(path))
+        prop = next((p for p in model.metadata_props if p.key == "classes"), None) or model.metadata_props.add()
+        prop.key, prop.value = "classes", json.dumps(classes)
+        onnx.save(model, str(path))
+    else:
+        import openvino as ov
+
+        xml = next(Path(path).glob("*.xml"))
+        model = ov.Core().read_model(str(xml))
+        model.set_rt_info(json.dumps(classes), ["model_info", "classes"])
+        ov.save_model(model, str(xml), compress_to_fp16=False)
+
+
+def quantize_int8(det_model, calib_images, imgsz, backend):
+    # The Detect head's anchor/DFL decode is not FX traceable, so each conv-carrying layer is quantized on its own
+    # (inputs/outputs stay float at the layer boundary) and the decode at the end of the head stays in float.
+    # The exported output is therefore still the float [1, 84, 8400] tensor that process_frame decodes.
+    from torch.ao.quantization import get_default_qconfig_mapping
+    from torch.ao.quantization.quantize_fx import convert_fx, prepare_fx
+
+    torch.backends.quantized.engine = backend
+    qconfig_mapping = get_default_qconfig_mapping(backend)
+
+    layers = det_model.model
+    head = layers[-1]
+    targets = [(layers, i) for i in range(len(layers) - 1) if any(isinstance(m, torch.nn.Conv2d) for m in layers[i].modules())]
+    targets += [(branch, i) for branch in (head.cv2, head.cv3) for i in range(len(branch))]
+
+    # Capture one real input per target so prepare_fx sees the right shapes.
+    example_inputs, hooks = {}, []
+
+    def capture(key):
+        def hook(module, args):
+            example_inputs.setdefault(key, args)
+        return hook
+
+    for parent, i in targets:
+        hooks.append(parent[i].register_forward_pre_hook(capture((id(parent), i))))
+    with torch.no_grad():
+        det_model(load_image(calib_images[0], imgsz))
+    for hook in hooks:
+        hook.remove()
+
+    for parent, i in targets:
+        original = parent[i]
+        # Wrapped so FX traces through the fused forward that Conv.fuse() installs on the instance.
+        prepared = prepare_fx(torch.nn.Sequential(original), qconfig_mapping, example_inputs[(id(parent), i)])
+        # ultralytics' forward routes tensors with these attributes.
+        for attr in ("f", "i", "type", "np"):
+            if hasattr(original, attr):
+                setattr(prepared, attr, getattr(original, attr))
+        parent[i] = prepared
+
+    with torch.no_grad():
+        for path in calib_images:
+            det_model(load_image(path, imgsz))
+
+    for parent, i in targets:
+        prepared = parent[i]
+        converted = convert_fx(prepared)
+        for attr in ("f", "i", "type", "np"):
+            if hasattr(prepared, attr):
+                setattr(converted, attr, getattr(prepared, attr))
+        parent[i] = converted
+
+    return det_model
+
+
+def export_int8(weights, imgsz, calib_dir, calib_count, backend, output, classes=None):
+    calib_images = list_images(calib_dir, calib_count)
+    if not calib_images:
+        raise SystemExit(f"No calibration images found in {calib_dir}")
+
+    det_model = YOLO(weights).model.float().fuse().eval()
+    if classes:
+        det_model = prune_classes(det_model, classes)
+    for m in det_model.modules():
+        if hasattr(m, "export"):
+            m.export = True  # Detect returns only the decoded [1, 84, 8400] tensor, as in the float export.
+
+    det_model = quantize_int8(det_model, calib_images, imgsz, backend)
+
+    with torch.no_grad():
+        traced = torch.jit.trace(det_model, load_image(calib_images[0], imgsz), strict=False)
+        traced = torch.jit.freeze(traced.eval())
+
+    # load_model reads config.txt to select the matching quantized engine before running forward.
+    meta = {"imgsz": [imgsz, imgsz], "precision": "int8", "qengine": backend, "calibration_images": len(calib_images)}
+    if classes:
+        meta["classes"] = classes
+    torch.jit.save(traced, output, _extra_files={"config.txt": json.dumps(meta)})
+    print(f"INT8 model saved to {output} ({len(calib_images)} calibration images, {backend} engine)")
+
+
+def append_decode_nms(path, ops_library, score_threshold, iou_threshold, max_det):
+    # Appends the yolo::decode_nms operator (src/yolo_ops.cpp) so forward returns [K, 6] detections
+    # (x, y, w, h, score, class_id) in model input pixels, instead of the raw [1, 84, 8400] predictions.
+    torch.ops.load_library(ops_library)
+
+    class DecodeNMS(torch.nn.Module):
+        def __init__(self, model):
+            super().__init__()
+            self.model = model
+            self.score_threshold = float(score_threshold)
+            self.iou_threshold = float(iou_threshold)
+            self.max_det = int(max_det)
+
+        def forward(self, x):
+            return torch.ops.yolo.decode_nms(self.model(x), self.score_threshold, self.iou_threshold, self.max_det)
+
+    extra_files = {"config.txt": ""}
+    base = torch.jit.load(path, map_location="cpu", _extra_files=extra_files)
+    scripted = torch.jit.script(DecodeNMS(base).eval())
+
+    output = str(Path(path).with_suffix("")) + "_nms.torchscript"
+    torch.jit.save(scripted, output, _extra_files=extra_files)
+    print(f"Model with in-graph decode/NMS saved to {output}")
+    return output
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Export YOLOv8 weights for libYOLO.so")
+    parser.add_argument("--weights", default="yolov8n.pt", help="Path to the ultralytics .pt model to convert")
+    parser.add_argument("--imgsz", type=int, default=640)
+    parser.add_argument("--int8", action="store_true", help="Post-training quantize to INT8 using --calib-dir")
+    parser.add_argument("--calib-dir", help="Directory of representative images for INT8 calibration")
+    parser.add_argument("--calib-count", type=int, default=200, help="Maximum number of calibration images")
+    parser.add_argument("--backend", default="x86", choices=["x86", "fbgemm", "onednn"], help="Quantized engine to target")
+    parser.add_argument("--onnx", action="store_true", help="Also export ONNX for the ONNX Runtime backend")
+    parser.add_argument("--openvino", action="store_true", help="Also export OpenVINO IR for the OpenVINO backend")
+    parser.add_argument("--dynamic", action="store_true",
+                        help="Export --onnx/--openvino with dynamic batch and input size (YOLOv8Options.input_size)")
+    parser.add_argument("--classes", help="Comma-separated COCO class ids to keep in a pruned head, e.g. 0,2")
+    parser.add_argument("--nms", action="store_true", help="Append the yolo::decode_nms operator to the TorchScript export")
+    parser.add_argument("--ops-library", default="../build/libyolo_ops.so", help="Built yolo_ops library (for --nms)")
+    parser.add_argument("--conf", type=float, default=0.25, help="Score threshold baked into --nms exports")
+    parser.add_argument("--iou", type=float, default=0.45, help="NMS IoU threshold baked into --nms exports")
+    parser.add_argument("--max-det", type=int, default=300, help="Maximum detections kept by --nms exports")
+    parser.add_argument("--output", help="Output path (defaults next to the weights)")
+    args = parser.parse_args()
+    classes = [int(c) for c in args.classes.split(",")] if args.classes else None
+
+    if args.int8:
+        if not args.calib_dir:
+            parser.error("--int8 requires --calib-dir")
+        output = args.output or str(Path(args.weights).with_suffix("")) + "_int8.torchscript"
+        export_int8(args.weights, args.imgsz, args.calib_dir, args.calib_count, args.backend, output, classes)
+    else:
+        model = YOLO(args.weights)
+        if classes:
+            prune_classes(model.model, classes)
+        output = model.export(format="torchscript", imgsz=args.imgsz)
+        exports = [output]
+        if args.onnx:
+            # Static 640x640, batch 1 graph simplified with onnxsim; same [1, 84, 8400] output as the TorchScript export.
+            # With --dynamic the anchor count follows the input size instead.
+            exports.append(model.export(format="onnx", imgsz=args.imgsz, opset=17, simplify=True, dynamic=args.dynamic))
+        if args.openvino:
+            # FP32 IR; the CPU plugin chooses its own inference precision (bf16 on AMX hosts).
+            exports.append(model.export(format="openvino", imgsz=args.imgsz, half=False, dynamic=args.dynamic))
+        if classes:
+            for path in exports:
+                tag_classes(path, classes)
 
-model.export(format="torchscript", imgsz=640)
\ No newline at end of file
+    if args.nms:
+        append_decode_nms(output, args.ops_library, args.conf, args.iou, args.max_det)
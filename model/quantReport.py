@@ -0,0 +1,120 @@
+# Compares the float and INT8 TorchScript exports on the same images and writes a markdown report.
+# Should be run from within the model directory, after modelExport.py has produced both models:
+#
+#   python quantReport.py --float yolov8n.torchscript --int8 yolov8n_int8.torchscript --images ../eval --threads 4
+#
+# Detections are decoded exactly as process_frame does (score >= 0.25, class-aware argmax, NMS at 0.45), so the
+# agreement numbers reflect what libYOLO.so callers would actually see. The float model's detections are used as the
+# reference: recall is the share of float detections the INT8 model reproduces (same class, IoU >= 0.5) and
+# precision is the share of INT8 detections that match a float detection.
+import argparse
+import json
+import statistics
+import time
+
+import torch
+import torchvision
+
+from modelExport import list_images, load_image
+
+
+def decode(output, score_threshold=0.25, nms_threshold=0.45):
+    rows = output[0].transpose(1, 0)
+    scores, class_ids = rows[:, 4:].max(1)
+    keep = scores >= score_threshold
+    rows, scores, class_ids = rows[keep], scores[keep], class_ids[keep]
+    boxes = torch.cat((rows[:, :2] - rows[:, 2:4] / 2, rows[:, :2] + rows[:, 2:4] / 2), 1)
+    # process_frame's apply_nms is class agnostic.
+    keep = torchvision.ops.nms(boxes, scores, nms_threshold)
+    return boxes[keep], scores[keep], class_ids[keep]
+
+
+def match(reference, candidate, iou_threshold=0.5):
+    ref_boxes, _, ref_classes = reference
+    boxes, _, classes = candidate
+    if len(ref_boxes) == 0 or len(boxes) == 0:
+        return 0
+    ious = torchvision.ops.box_iou(ref_boxes, boxes)
+    ious[ref_classes[:, None] != classes[None, :]] = 0
+    matched, used = 0, set()
+    for i in range(len(ref_boxes)):
+        j = int(ious[i].argmax())
+        if ious[i, j] >= iou_threshold and j not in used:
+            used.add(j)
+            matched += 1
+    return matched
+
+
+def run(model, images, warmup):
+    latencies, detections = [], []
+    with torch.no_grad():
+        for _ in range(warmup):
+            model(images[0])
+        for image in images:
+            start = time.perf_counter()
+            output = model(image)
+            latencies.append((time.perf_counter() - start) * 1000)
+            detections.append(decode(output.float()))
+    return latencies, detections
+
+
+def percentile(values, q):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(round(q * (len(ordered) - 1))))]
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Accuracy vs latency of the INT8 export against the float export")
+    parser.add_argument("--float", dest="float_model", default="yolov8n.torchscript")
+    parser.add_argument("--int8", dest="int8_model", default="yolov8n_int8.torchscript")
+    parser.add_argument("--images", required=True, help="Directory of evaluation images (ideally not the calibration set)")
+    parser.add_argument("--count", type=int, default=500)
+    parser.add_argument("--imgsz", type=int, default=640)
+    parser.add_argument("--threads", type=int, default=0, help="torch intra-op threads (0 keeps the default)")
+    parser.add_argument("--warmup", type=int, default=5)
+    parser.add_argument("--report", default="quantReport.md")
+    args = parser.parse_args()
+
+    if args.threads:
+        torch.set_num_threads(args.threads)
+
+    extra_files = {"config.txt": ""}
+    int8_model = torch.jit.load(args.int8_model, map_location="cpu", _extra_files=extra_files)
+    torch.backends.quantized.engine = json.loads(extra_files["config.txt"] or "{}").get("qengine", "x86")
+    float_model = torch.jit.load(args.float_model, map_location="cpu")
+
+    images = [load_image(path, args.imgsz) for path in list_images(args.images, args.count)]
+    if not images:
+        raise SystemExit(f"No images found in {args.images}")
+
+    float_latency, float_detections = run(float_model, images, args.warmup)
+    int8_latency, int8_detections = run(int8_model, images, args.warmup)
+
+    matched = sum(match(f, q) for f, q in zip(float_detections, int8_detections))
+    float_count = sum(len(d[0]) for d in float_detections)
+    int8_count = sum(len(d[0]) for d in int8_detections)
+    recall = matched / float_count if float_count else 1.0
+    precision = matched / int8_count if int8_count else 1.0
+
+    lines = [
+        "# INT8 vs float report",
+        "",
+        f"{len(images)} images from `{args.images}` at {args.imgsz}x{args.imgsz}, "
+        f"{torch.get_num_threads()} intra-op threads, quantized engine `{torch.backends.quantized.engine}`.",
+        "",
+        "| Model | Mean ms | p50 ms | p95 ms | Detections |",
+        "|---|---|---|---|---|",
+    ]
+    for name, latency, count in (("float", float_latency, float_count), ("int8", int8_latency, int8_count)):
+        lines.append(f"| {name} | {statistics.mean(latency):.2f} | {percentile(latency, 0.5):.2f} | {percentile(latency, 0.95):.2f} | {count} |")
+    lines += [
+        "",
+        f"Speed-up (mean): {statistics.mean(float_latency) / statistics.mean(int8_latency):.2f}x",
+        "",
+        f"Agreement with float (IoU >= 0.5, same class): recall {recall:.3f}, precision {precision:.3f}",
+        "",
+    ]
+
+    with open(args.report, "w") as f:
+        f.write("\n".join(lines))
+    print("\n".join(lines))
@@ -0,0 +1,425 @@
+#include "async_io.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef YOLO_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+namespace {
+    const int max_depth = 4096;
+
+    // Returns 0 or the errno of the failing call.
+    int read_whole_file(const char* path, std::vector<unsigned char>& bytes) {
+        int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return errno;
+        struct stat info {};
+        if (fstat(fd, &info) != 0) {
+            int error = errno;
+            close(fd);
+            return error;
+        }
+        bytes.resize(static_cast<size_t>(info.st_size));
+        size_t offset = 0;
+        int error = 0;
+        while (offset < bytes.size()) {
+            ssize_t n = pread(fd, bytes.data() + offset, bytes.size() - offset, static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                error = errno;
+                break;
+            }
+            if (n == 0) {
+                bytes.resize(offset);   // Truncated since fstat
+                break;
+            }
+            offset += static_cast<size_t>(n);
+        }
+        close(fd);
+        return error;
+    }
+
+    int write_whole_file(const char* path, const std::vector<unsigned char>& bytes) {
+        int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return errno;
+        size_t offset = 0;
+        int error = 0;
+        while (offset < bytes.size()) {
+            ssize_t n = pwrite(fd, bytes.data() + offset, bytes.size() - offset, static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                error = errno;
+                break;
+            }
+            offset += static_cast<size_t>(n);
+        }
+        // Network file systems may only report a failed write when the file is closed.
+        if (close(fd) != 0 && !error) error = errno;
+        return error;
+    }
+
+#ifdef YOLO_HAVE_LIBURING
+    // A ring supporting every opcode used below, or false to fall back to blocking I/O.
+    bool init_ring(io_uring& ring, int depth) {
+        if (io_uring_queue_init(static_cast<unsigned>(depth), &ring, 0) != 0) return false;
+        io_uring_probe* probe = io_uring_get_probe_ring(&ring);
+        bool supported = probe && io_uring_opcode_supported(probe, IORING_OP_OPENAT) &&
+                         io_uring_opcode_supported(probe, IORING_OP_READ) && io_uring_opcode_supported(probe, IORING_OP_WRITE) &&
+                         io_uring_opcode_supported(probe, IORING_OP_CLOSE);
+        if (probe) io_uring_free_probe(probe);
+        if (!supported) io_uring_queue_exit(&ring);
+        return supported;
+    }
+
+    // One file going through open, read or write (resubmitted after short transfers) and close, one operation on the
+    // ring at a time. The size of a file being read comes from fstat on the opened descriptor, which is answered from
+    // the attributes fetched by the open, also on network file systems.
+    struct FileRequest {
+        enum Step { Open, Transfer, Close };
+
+        bool writing = false;
+        std::string path;
+        FileData file;
+        Step step = Open;
+        int fd = -1;
+        size_t offset = 0;
+    };
+
+    io_uring_sqe* next_sqe(io_uring& ring) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        if (!sqe) {
+            io_uring_submit(&ring);
+            sqe = io_uring_get_sqe(&ring);
+        }
+        return sqe;
+    }
+
+    // The ring has at least depth entries and each request has one operation queued at a time, so an entry is
+    // always free.
+    void submit_step(io_uring& ring, FileRequest* request) {
+        io_uring_sqe* sqe = next_sqe(ring);
+        switch (request->step) {
+        case FileRequest::Open:
+            io_uring_prep_openat(sqe, AT_FDCWD, request->path.c_str(),
+                                 request->writing ? O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0644);
+            break;
+        case FileRequest::Transfer: {
+            auto& bytes = request->file.bytes;
+            unsigned length = static_cast<unsigned>(std::min<size_t>(bytes.size() - request->offset, 1u << 30));
+            if (request->writing) io_uring_prep_write(sqe, request->fd, bytes.data() + request->offset, length, request->offset);
+            else io_uring_prep_read(sqe, request->fd, bytes.data() + request->offset, length, request->offset);
+            break;
+        }
+        case FileRequest::Close:
+            io_uring_prep_close(sqe, request->fd);
+            break;
+        }
+        io_uring_sqe_set_data(sqe, request);
+    }
+
+    void fail(FileRequest* request, int error) {
+        if (!request->file.error) request->file.error = error;
+        request->step = FileRequest::Close;
+    }
+
+    // Moves a request on after the completion of its current operation and queues the next one. Returns true once the
+    // request is finished (file.error is set if any step failed).
+    bool advance(io_uring& ring, FileRequest* request, int result) {
+        switch (request->step) {
+        case FileRequest::Open:
+            if (result < 0) {
+                request->file.error = -result;
+                return true;
+            }
+            request->fd = result;
+            request->step = FileRequest::Transfer;
+            if (!request->writing) {
+                struct stat info {};
+                if (fstat(request->fd, &info) != 0) fail(request, errno);
+                else request->file.bytes.resize(static_cast<size_t>(info.st_size));
+            }
+            if (request->file.bytes.empty()) request->step = FileRequest::Close;
+            break;
+        case FileRequest::Transfer:
+            if (result == -EINTR || result == -EAGAIN) break;
+            if (result < 0) {
+                fail(request, -result);
+            } else if (result == 0) {
+                // A read hit the end of a file truncated since fstat; a write that makes no progress is an error.
+                if (request->writing) fail(request, EIO);
+                else request->file.bytes.resize(request->offset);
+                request->step = FileRequest::Close;
+            } else {
+                request->offset += static_cast<size_t>(result);
+                if (request->offset >= request->file.bytes.size()) request->step = FileRequest::Close;
+            }
+            break;
+        case FileRequest::Close:
+            if (result < 0 && !request->file.error) request->file.error = -result;
+            return true;
+        }
+        submit_step(ring, request);
+        return false;
+    }
+
+    // Waits for the next completion and advances its request; returns the request once it is finished.
+    FileRequest* complete_one(io_uring& ring) {
+        io_uring_cqe* cqe;
+        int waited;
+        while ((waited = io_uring_wait_cqe(&ring, &cqe)) == -EINTR) {}
+        if (waited != 0) return nullptr;
+        auto* request = static_cast<FileRequest*>(io_uring_cqe_get_data(cqe));
+        int result = cqe->res;
+        io_uring_cqe_seen(&ring, cqe);
+        bool finished = advance(ring, request, result);
+        io_uring_submit(&ring);
+        return finished ? request : nullptr;
+    }
+#endif
+}
+
+struct FilePrefetcher::State {
+    const std::vector<std::string>* paths = nullptr;
+    size_t depth = 1;
+    std::mutex mutex;
+    std::condition_variable ready_changed;
+    std::condition_variable space_freed;
+    std::deque<FileData> ready;
+    size_t issued = 0;          // Paths handed to a read
+    size_t in_flight = 0;
+    bool stopping = false;
+    bool using_io_uring = false;
+    std::vector<std::thread> threads;
+#ifdef YOLO_HAVE_LIBURING
+    ::io_uring ring;
+#endif
+
+    bool more() const { return !stopping && issued < paths->size(); }
+    bool has_room() const { return in_flight + ready.size() < depth; }
+    bool finished() const { return stopping || (issued >= paths->size() && in_flight == 0); }
+
+    void complete(FileData file) {
+        std::lock_guard<std::mutex> lock(mutex);
+        --in_flight;
+        if (!stopping) ready.push_back(std::move(file));
+        if (finished()) ready_changed.notify_all();
+        else ready_changed.notify_one();
+    }
+
+    void run_blocking() {
+        for (;;) {
+            FileData file;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                space_freed.wait(lock, [this] { return !more() || has_room(); });
+                if (!more()) return;
+                file.index = issued++;
+                ++in_flight;
+            }
+            file.error = read_whole_file((*paths)[file.index].c_str(), file.bytes);
+            complete(std::move(file));
+        }
+    }
+
+#ifdef YOLO_HAVE_LIBURING
+    // Opens are queued for as many files as there is room for; the thread then sleeps in the ring until something
+    // completes, and only waits for room when nothing is in flight.
+    void run_io_uring() {
+        size_t active = 0;
+        for (;;) {
+            std::vector<size_t> claimed;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (active == 0) space_freed.wait(lock, [this] { return !more() || has_room(); });
+                while (more() && has_room()) {
+                    claimed.push_back(issued++);
+                    ++in_flight;
+                }
+                if (active == 0 && claimed.empty()) break;
+            }
+            for (size_t index : claimed) {
+                auto* request = new FileRequest;
+                request->path = (*paths)[index];
+                request->file.index = index;
+                submit_step(ring, request);
+                ++active;
+            }
+            io_uring_submit(&ring);
+
+            if (FileRequest* request = complete_one(ring)) {
+                --active;
+                complete(std::move(request->file));
+                delete request;
+            }
+        }
+        io_uring_queue_exit(&ring);
+    }
+#endif
+};
+
+FilePrefetcher::FilePrefetcher() : state_(new State) {}
+
+FilePrefetcher::~FilePrefetcher() {
+    stop();
+    for (auto& thread : state_->threads) thread.join();
+}
+
+void FilePrefetcher::start(const std::vector<std::string>& paths, int depth) {
+    State* state = state_.get();
+    state->paths = &paths;
+    state->depth = static_cast<size_t>(std::max(1, std::min(depth, max_depth)));
+#ifdef YOLO_HAVE_LIBURING
+    state->using_io_uring = init_ring(state->ring, static_cast<int>(state->depth));
+    if (state->using_io_uring) {
+        state->threads.emplace_back([state] { state->run_io_uring(); });
+        return;
+    }
+#endif
+    for (size_t t = 0; t < std::min(state->depth, paths.size()); ++t) {
+        state->threads.emplace_back([state] { state->run_blocking(); });
+    }
+}
+
+bool FilePrefetcher::next(FileData& file) {
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    state_->ready_changed.wait(lock, [this] { return !state_->ready.empty() || state_->finished(); });
+    if (state_->ready.empty()) return false;
+    file = std::move(state_->ready.front());
+    state_->ready.pop_front();
+    state_->space_freed.notify_one();
+    return true;
+}
+
+void FilePrefetcher::stop() {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->stopping = true;
+    state_->ready.clear();
+    state_->ready_changed.notify_all();
+    state_->space_freed.notify_all();
+}
+
+bool FilePrefetcher::uses_io_uring() const {
+    return state_->using_io_uring;
+}
+
+struct FileWriter::State {
+    struct Job {
+        std::string path;
+        std::vector<unsigned char> bytes;
+    };
+
+    size_t depth = 1;
+    std::mutex mutex;
+    std::condition_variable queued;
+    std::condition_variable space_freed;
+    std::deque<Job> pending;
+    size_t outstanding = 0;     // Queued or in flight
+    size_t failures = 0;
+    bool finishing = false;
+    std::vector<std::thread> threads;
+#ifdef YOLO_HAVE_LIBURING
+    ::io_uring ring;
+#endif
+
+    void complete(const std::string& path, int error) {
+        std::lock_guard<std::mutex> lock(mutex);
+        --outstanding;
+        if (error) {
+            ++failures;
+            std::cerr << "Failed to write " << path << ": " << std::strerror(error) << std::endl;
+        }
+        space_freed.notify_one();
+    }
+
+    void run_blocking() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                queued.wait(lock, [this] { return !pending.empty() || finishing; });
+                if (pending.empty()) return;
+                job = std::move(pending.front());
+                pending.pop_front();
+            }
+            complete(job.path, write_whole_file(job.path.c_str(), job.bytes));
+        }
+    }
+
+#ifdef YOLO_HAVE_LIBURING
+    void run_io_uring() {
+        size_t active = 0;
+        for (;;) {
+            std::deque<Job> jobs;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (active == 0) queued.wait(lock, [this] { return !pending.empty() || finishing; });
+                jobs.swap(pending);
+                if (active == 0 && jobs.empty()) break;
+            }
+            for (auto& job : jobs) {
+                auto* request = new FileRequest;
+                request->writing = true;
+                request->path = std::move(job.path);
+                request->file.bytes = std::move(job.bytes);
+                submit_step(ring, request);
+                ++active;
+            }
+            io_uring_submit(&ring);
+
+            if (FileRequest* request = complete_one(ring)) {
+                --active;
+                complete(request->path, request->file.error);
+                delete request;
+            }
+        }
+        io_uring_queue_exit(&ring);
+    }
+#endif
+};
+
+FileWriter::FileWriter() : state_(new State) {}
+
+FileWriter::~FileWriter() {
+    finish();
+}
+
+void FileWriter::start(int depth) {
+    State* state = state_.get();
+    state->depth = static_cast<size_t>(std::max(1, std::min(depth, max_depth)));
+#ifdef YOLO_HAVE_LIBURING
+    if (init_ring(state->ring, static_cast<int>(state->depth))) {
+        state->threads.emplace_back([state] { state->run_io_uring(); });
+        return;
+    }
+#endif
+    for (size_t t = 0; t < state->depth; ++t) {
+        state->threads.emplace_back([state] { state->run_blocking(); });
+    }
+}
+
+void FileWriter::write(const std::string& path, std::vector<unsigned char> bytes) {
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    state_->space_freed.wait(lock, [this] { return state_->outstanding < state_->depth; });
+    ++state_->outstanding;
+    state_->pending.push_back({path, std::move(bytes)});
+    state_->queued.notify_one();
+}
+
+size_t FileWriter::finish() {
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->finishing = true;
+        state_->queued.notify_all();
+    }
+    for (auto& thread : state_->threads) thread.join();
+    state_->threads.clear();
+    return state_->failures;
+}
@@ -0,0 +1,79 @@
+#include "cpu_affinity.h"
+#ifdef __linux__
+#include <sched.h>
+#endif
+#ifdef YOLO_HAVE_LIBNUMA
+#include <numa.h>
+#include <mutex>
+
+namespace {
+    // libnuma fills its node-to-CPUs cache without locking, and replica workers bind at the same time.
+    std::mutex numa_mutex;
+}
+#endif
+
+std::vector<int> thread_cpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    }
+#endif
+    return cpus;
+}
+
+bool pin_thread(const std::vector<int>& cpus) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    // sched_setaffinity with pid 0 applies to the calling thread only, not the whole process.
+    return CPU_COUNT(&set) > 0 && sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+ScopedAffinity::ScopedAffinity(const std::vector<int>& cpus) {
+    if (cpus.empty()) return;
+    previous_ = thread_cpus();
+    pinned_ = pin_thread(cpus);
+}
+
+ScopedAffinity::~ScopedAffinity() {
+    if (pinned_) pin_thread(previous_);
+}
+
+std::vector<int> numa_nodes() {
+    std::vector<int> nodes;
+#ifdef YOLO_HAVE_LIBNUMA
+    std::lock_guard<std::mutex> lock(numa_mutex);
+    if (numa_available() < 0) return nodes;
+    struct bitmask* cpus = numa_allocate_cpumask();
+    for (int node = 0; node <= numa_max_node(); ++node) {
+        // Memory-only nodes (CXL, HBM) have no CPUs to run a replica on.
+        if (numa_node_to_cpus(node, cpus) == 0 && numa_bitmask_weight(cpus) > 0) nodes.push_back(node);
+    }
+    numa_free_cpumask(cpus);
+#endif
+    return nodes;
+}
+
+bool bind_thread_to_node(int node) {
+#ifdef YOLO_HAVE_LIBNUMA
+    std::lock_guard<std::mutex> lock(numa_mutex);
+    if (numa_available() < 0 || numa_run_on_node(node) != 0) return false;
+    numa_set_preferred(node);
+    return true;
+#else
+    (void)node;
+    return false;
+#endif
+}
@@ -0,0 +1,236 @@
+#include "labels.h"
+#include "postprocess.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+const char* const COCO_CLASSES[80] = {
+    "person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat", "traffic light",
+    "fire hydrant", "stop sign", "parking meter", "bench", "bird", "cat", "dog", "horse", "sheep", "cow",
+    "elephant", "bear", "zebra", "giraffe", "backpack", "umbrella", "handbag", "tie", "suitcase", "frisbee",
+    "skis", "snowboard", "sports ball", "kite", "baseball bat", "baseball glove", "skateboard", "surfboard", "tennis racket", "bottle",
+    "wine glass", "cup", "fork", "knife", "spoon", "bowl", "banana", "apple", "sandwich", "orange",
+    "broccoli", "carrot", "hot dog", "pizza", "donut", "cake", "chair", "couch", "potted plant", "bed",
+    "dining table", "toilet", "tv", "laptop", "mouse", "remote", "keyboard", "cell phone", "microwave", "oven",
+    "toaster", "sink", "refrigerator", "book", "clock", "vase", "scissors", "teddy bear", "hair drier", "toothbrush"
+};
+
+namespace {
+    const int GLYPH_WIDTH = 5;
+    const int GLYPH_HEIGHT = 7;
+    const int FIRST_GLYPH = 32;  // ' '
+    const int LAST_GLYPH = 126;  // '~'
+    const int GLYPH_COUNT = LAST_GLYPH - FIRST_GLYPH + 1;
+    const int MAX_SCALE = 3;
+
+    // One byte per row, bit 4 is the leftmost column.
+    const unsigned char FONT_5X7[GLYPH_COUNT][GLYPH_HEIGHT] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04}, // '!'
+    {0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00}, // '"'
+    {0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A}, // '#'
+    {0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04}, // '$'
+    {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}, // '%'
+    {0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D}, // '&'
+    {0x04, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00}, // '''
+    {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}, // '('
+    {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}, // ')'
+    {0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00}, // '*'
+    {0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00}, // '+'
+    {0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08}, // ','
+    {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}, // '-'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}, // '.'
+    {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}, // '/'
+    {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, // '0'
+    {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}, // '1'
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}, // '2'
+    {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}, // '3'
+    {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, // '4'
+    {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}, // '5'
+    {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, // '6'
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // '7'
+    {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, // '8'
+    {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}, // '9'
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}, // ':'
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08}, // ';'
+    {0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02}, // '<'
+    {0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00}, // '='
+    {0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08}, // '>'
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04}, // '?'
+    {0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E}, // '@'
+    {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // 'A'
+    {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}, // 'B'
+    {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}, // 'C'
+    {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C}, // 'D'
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}, // 'E'
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}, // 'F'
+    {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}, // 'G'
+    {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // 'H'
+    {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}, // 'I'
+    {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}, // 'J'
+    {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, // 'K'
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}, // 'L'
+    {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}, // 'M'
+    {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}, // 'N'
+    {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // 'O'
+    {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}, // 'P'
+    {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}, // 'Q'
+    {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}, // 'R'
+    {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}, // 'S'
+    {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, // 'T'
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // 'U'
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}, // 'V'
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}, // 'W'
+    {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}, // 'X'
+    {0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04}, // 'Y'
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}, // 'Z'
+    {0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E}, // '['
+    {0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00}, // backslash
+    {0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E}, // ']'
+    {0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00}, // '^'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F}, // '_'
+    {0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00}, // '`'
+    {0x00, 0x00, 0x0E, 0x01, 0x0F, 0x11, 0x0F}, // 'a'
+    {0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1E}, // 'b'
+    {0x00, 0x00, 0x0E, 0x10, 0x10, 0x11, 0x0E}, // 'c'
+    {0x01, 0x01, 0x0D, 0x13, 0x11, 0x11, 0x0F}, // 'd'
+    {0x00, 0x00, 0x0E, 0x11, 0x1F, 0x10, 0x0E}, // 'e'
+    {0x06, 0x09, 0x08, 0x1C, 0x08, 0x08, 0x08}, // 'f'
+    {0x00, 0x0F, 0x11, 0x11, 0x0F, 0x01, 0x0E}, // 'g'
+    {0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11}, // 'h'
+    {0x04, 0x00, 0x0C, 0x04, 0x04, 0x04, 0x0E}, // 'i'
+    {0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0C}, // 'j'
+    {0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12}, // 'k'
+    {0x0C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}, // 'l'
+    {0x00, 0x00, 0x1A, 0x15, 0x15, 0x11, 0x11}, // 'm'
+    {0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11}, // 'n'
+    {0x00, 0x00, 0x0E, 0x11, 0x11, 0x11, 0x0E}, // 'o'
+    {0x00, 0x00, 0x1E, 0x11, 0x1E, 0x10, 0x10}, // 'p'
+    {0x00, 0x00, 0x0D, 0x13, 0x0F, 0x01, 0x01}, // 'q'
+    {0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10}, // 'r'
+    {0x00, 0x00, 0x0E, 0x10, 0x0E, 0x01, 0x1E}, // 's'
+    {0x08, 0x08, 0x1C, 0x08, 0x08, 0x09, 0x06}, // 't'
+    {0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0D}, // 'u'
+    {0x00, 0x00, 0x11, 0x11, 0x11, 0x0A, 0x04}, // 'v'
+    {0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0A}, // 'w'
+    {0x00, 0x00, 0x11, 0x0A, 0x04, 0x0A, 0x11}, // 'x'
+    {0x00, 0x00, 0x11, 0x11, 0x0F, 0x01, 0x0E}, // 'y'
+    {0x00, 0x00, 0x1F, 0x02, 0x04, 0x08, 0x1F}, // 'z'
+    {0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02}, // '{'
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, // '|'
+    {0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08}, // '}'
+    {0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00}, // '~'
+    };
+
+    // Same colours as draw_rectangles so the label reads as a tag on the box.
+    const std::array<unsigned char, 3> LABEL_FOREGROUND = {0, 0, 0};
+    const std::array<unsigned char, 3> LABEL_BACKGROUND = {0, 255, 0};
+}
+
+void build_glyph_atlas(GlyphAtlas& atlas, int scale, const std::array<unsigned char, 3>& foreground, const std::array<unsigned char, 3>& background) {
+    // Each cell has one (scaled) column of spacing on the right and a row of padding above and below.
+    atlas.scale = scale;
+    atlas.cell_width = (GLYPH_WIDTH + 1) * scale;
+    atlas.cell_height = (GLYPH_HEIGHT + 2) * scale;
+    atlas.pixels.assign(static_cast<size_t>(GLYPH_COUNT) * atlas.cell_height * atlas.cell_width * 3, 0);
+
+    for (int g = 0; g < GLYPH_COUNT; ++g) {
+        for (int y = 0; y < atlas.cell_height; ++y) {
+            int glyph_row = y / scale - 1;
+            unsigned char* row = atlas.pixels.data() + (static_cast<size_t>(g) * atlas.cell_height + y) * atlas.cell_width * 3;
+            for (int x = 0; x < atlas.cell_width; ++x) {
+                int glyph_col = x / scale;
+                bool on = glyph_row >= 0 && glyph_row < GLYPH_HEIGHT && glyph_col < GLYPH_WIDTH &&
+                          (FONT_5X7[g][glyph_row] >> (GLYPH_WIDTH - 1 - glyph_col)) & 1;
+                const auto& colour = on ? foreground : background;
+                row[x * 3] = colour[0];
+                row[x * 3 + 1] = colour[1];
+                row[x * 3 + 2] = colour[2];
+            }
+        }
+    }
+}
+
+void build_label_renderer(LabelRenderer& renderer) {
+    renderer.atlases.resize(MAX_SCALE);
+    for (int scale = 1; scale <= MAX_SCALE; ++scale) {
+        build_glyph_atlas(renderer.atlases[scale - 1], scale, LABEL_FOREGROUND, LABEL_BACKGROUND);
+    }
+}
+
+const GlyphAtlas& select_atlas(const LabelRenderer& renderer, int image_height) {
+    // Roughly one scale step per 720 rows: 1x up to 720p, 2x for 1080p/1440p, 3x for 4K.
+    int scale = std::clamp(image_height / 720 + 1, 1, static_cast<int>(renderer.atlases.size()));
+    return renderer.atlases[scale - 1];
+}
+
+int format_label(char* buffer, int buffer_size, int class_id, float score) {
+    const char* name = (class_id >= 0 && class_id < 80) ? COCO_CLASSES[class_id] : "unknown";
+    int length = std::snprintf(buffer, buffer_size, "%s %.2f", name, score);
+    return std::clamp(length, 0, buffer_size - 1);
+}
+
+void draw_text(const GlyphAtlas& atlas, unsigned char* image_data, int width, int height, int x, int y, const char* text, int length) {
+    // Clip once for the whole string; then each output row is filled left to right with one memcpy per glyph,
+    // so the destination is walked row by row rather than glyph by glyph.
+    int first_row = std::max(0, -y);
+    int last_row = std::min(atlas.cell_height, height - y);
+    if (first_row >= last_row || x >= width) return;
+
+    const int MAX_LABEL = 64;
+    const unsigned char* glyph_rows[MAX_LABEL];
+    int glyph_cols[MAX_LABEL][2];
+    int visible = 0;
+    size_t cell_row_bytes = static_cast<size_t>(atlas.cell_width) * 3;
+    size_t cell_bytes = cell_row_bytes * atlas.cell_height;
+
+    for (int c = 0; c < length && visible < MAX_LABEL; ++c) {
+        int cell_x = x + c * atlas.cell_width;
+        if (cell_x >= width) break;
+        int first_col = std::max(0, -cell_x);
+        int last_col = std::min(atlas.cell_width, width - cell_x);
+        if (first_col >= last_col) continue;
+
+        int g = static_cast<unsigned char>(text[c]) - FIRST_GLYPH;
+        if (g < 0 || g >= GLYPH_COUNT) g = '?' - FIRST_GLYPH;
+
+        glyph_rows[visible] = atlas.pixels.data() + g * cell_bytes + first_col * 3;
+        glyph_cols[visible][0] = cell_x + first_col;
+        glyph_cols[visible][1] = last_col - first_col;
+        ++visible;
+    }
+
+    for (int row = first_row; row < last_row; ++row) {
+        unsigned char* dst = image_data + static_cast<size_t>(y + row) * width * 3;
+        for (int c = 0; c < visible; ++c) {
+            std::memcpy(dst + glyph_cols[c][0] * 3, glyph_rows[c] + row * cell_row_bytes, glyph_cols[c][1] * 3);
+        }
+    }
+}
+
+void draw_labels(unsigned char* image_data, int width, int height, const LabelRenderer& renderer, const std::vector<std::tuple<std::array<float, 4>, float, int>>& nms_boxes) {
+    draw_labels_band(image_data, width, height, 0, height, renderer, nms_boxes);
+}
+
+void draw_labels_band(unsigned char* band, int width, int height, int band_top, int band_rows, const LabelRenderer& renderer, const std::vector<std::tuple<std::array<float, 4>, float, int>>& nms_boxes) {
+    if (renderer.atlases.empty()) return;
+
+    float scale_x = static_cast<float>(width) / reference_size;
+    float scale_y = static_cast<float>(height) / reference_size;
+    const GlyphAtlas& atlas = select_atlas(renderer, height);
+
+    char label[64];
+    for (const auto& box_info : nms_boxes) {
+        const auto& box = std::get<0>(box_info);
+        int left = static_cast<int>(box[0] * scale_x);
+        int top = static_cast<int>(box[1] * scale_y);
+
+        // Sit on top of the box, or inside it when there is no room above.
+        int y = top - atlas.cell_height;
+        if (y < 0) y = std::max(0, top);
+        if (y >= band_top + band_rows || y + atlas.cell_height <= band_top) continue;
+
+        int length = format_label(label, sizeof(label), std::get<2>(box_info), std::get<1>(box_info));
+        draw_text(atlas, band, width, band_rows, std::max(0, left), y - band_top, label, length);
+    }
+}
@@ -0,0 +1,99 @@
+#include "motion_gate.h"
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // The background moves 1/2^shift of the way towards each new frame.
+    const int background_shift = 3;
+
+    // Sum of absolute differences per 8x8 block of two thumbnails; one psadbw covers two horizontally adjacent blocks'
+    // rows, so each thumbnail row is five loads.
+    void block_sad(const uint8_t* a, const uint8_t* b, uint32_t* sums) {
+        const int n = MotionGate::thumbnail_size;
+        const int blocks = n / MotionGate::block_size;
+        std::fill(sums, sums + blocks * blocks, 0);
+        for (int y = 0; y < n; ++y) {
+            uint32_t* block_row = sums + (y / MotionGate::block_size) * blocks;
+#if defined(__SSE2__)
+            for (int x = 0; x < n; x += 16) {
+                __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + y * n + x));
+                __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + y * n + x));
+                __m128i sad = _mm_sad_epu8(va, vb);
+                block_row[x / 8] += static_cast<uint32_t>(_mm_cvtsi128_si32(sad));
+                block_row[x / 8 + 1] += static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(sad, 8)));
+            }
+#else
+            for (int x = 0; x < n; ++x) {
+                int diff = a[y * n + x] - b[y * n + x];
+                block_row[x / 8] += static_cast<uint32_t>(diff < 0 ? -diff : diff);
+            }
+#endif
+        }
+    }
+}
+
+// About four rows per block are sampled and channels are summed before the luma weights are applied, which keeps this
+// to three adds per sample.
+void gray_thumbnail(const unsigned char* rgb, int size, int n, uint8_t* out, ThumbnailScratch& scratch) {
+    int row_step = std::max(1, size / n / 4);
+    std::vector<int>& column_block = scratch.column_block;
+    std::vector<uint32_t>& column_count = scratch.column_count;
+    column_block.resize(size);
+    column_count.assign(n, 0);
+    for (int x = 0; x < size; ++x) {
+        column_block[x] = x * n / size;
+        ++column_count[column_block[x]];
+    }
+
+    std::vector<uint32_t>& sums = scratch.sums;
+    sums.resize(n * 3);
+    for (int ty = 0; ty < n; ++ty) {
+        int y_begin = ty * size / n;
+        int y_end = std::max(y_begin + 1, (ty + 1) * size / n);
+        std::fill(sums.begin(), sums.end(), 0);
+        uint32_t rows = 0;
+        for (int y = y_begin; y < y_end && y < size; y += row_step, ++rows) {
+            const unsigned char* pixel = rgb + static_cast<size_t>(y) * size * 3;
+            for (int x = 0; x < size; ++x, pixel += 3) {
+                uint32_t* sum = sums.data() + column_block[x] * 3;
+                sum[0] += pixel[0];
+                sum[1] += pixel[1];
+                sum[2] += pixel[2];
+            }
+        }
+        for (int tx = 0; tx < n; ++tx) {
+            const uint32_t* sum = sums.data() + tx * 3;
+            uint32_t count = (column_count[tx] * rows) << 8;
+            out[ty * n + tx] = static_cast<uint8_t>(count ? (77 * sum[0] + 150 * sum[1] + 29 * sum[2]) / count : 0);
+        }
+    }
+}
+
+bool MotionGate::is_static(const unsigned char* rgb, int size) {
+    const int pixels = thumbnail_size * thumbnail_size;
+    thumbnail_.resize(pixels);
+    gray_thumbnail(rgb, size, thumbnail_size, thumbnail_.data(), scratch_);
+
+    if (background_.size() != static_cast<size_t>(pixels)) {
+        background_ = thumbnail_;
+        background_q8_.assign(pixels, 0);
+        for (int i = 0; i < pixels; ++i) background_q8_[i] = static_cast<uint16_t>(background_[i] << 8);
+        return false;
+    }
+
+    const int blocks = thumbnail_size / block_size;
+    uint32_t sums[blocks * blocks];
+    block_sad(thumbnail_.data(), background_.data(), sums);
+    uint32_t limit = static_cast<uint32_t>(threshold_ * block_size * block_size);
+    bool changed = std::any_of(sums, sums + blocks * blocks, [&](uint32_t sum) { return sum > limit; });
+
+    for (int i = 0; i < pixels; ++i) {
+        int current = background_q8_[i];
+        current += ((thumbnail_[i] << 8) - current) >> background_shift;
+        background_q8_[i] = static_cast<uint16_t>(current);
+        background_[i] = static_cast<uint8_t>((current + 128) >> 8);
+    }
+    return !changed;
+}
@@ -0,0 +1,178 @@
+#include "near_duplicate.h"
+#include "motion_gate.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const int dct_size = 32;
+    const int hash_size = 8;
+
+    // cos((2x + 1) u pi / 2N) for the first hash_size frequencies u.
+    struct DctTable {
+        float c[hash_size][dct_size];
+        DctTable() {
+            for (int u = 0; u < hash_size; ++u) {
+                for (int x = 0; x < dct_size; ++x) {
+                    c[u][x] = static_cast<float>(std::cos((2 * x + 1) * u * M_PI / (2 * dct_size)));
+                }
+            }
+        }
+    };
+
+    int hamming(uint64_t a, uint64_t b) { return __builtin_popcountll(a ^ b); }
+}
+
+uint64_t perceptual_hash(const unsigned char* rgb, int size, ThumbnailScratch& scratch) {
+    static const DctTable table;
+    uint8_t gray[dct_size * dct_size];
+    gray_thumbnail(rgb, size, dct_size, gray, scratch);
+
+    // Separable DCT, keeping only the low frequencies: rows first, then columns of the 8 kept row coefficients.
+    float rows[dct_size][hash_size];
+    for (int y = 0; y < dct_size; ++y) {
+        for (int u = 0; u < hash_size; ++u) {
+            float sum = 0.0f;
+            for (int x = 0; x < dct_size; ++x) sum += table.c[u][x] * gray[y * dct_size + x];
+            rows[y][u] = sum;
+        }
+    }
+    float coefficients[hash_size * hash_size];
+    for (int v = 0; v < hash_size; ++v) {
+        for (int u = 0; u < hash_size; ++u) {
+            float sum = 0.0f;
+            for (int y = 0; y < dct_size; ++y) sum += table.c[v][y] * rows[y][u];
+            coefficients[v * hash_size + u] = sum;
+        }
+    }
+
+    // The DC term only tracks overall brightness, so it is left out of the median.
+    float sorted[hash_size * hash_size - 1];
+    std::copy(coefficients + 1, coefficients + hash_size * hash_size, sorted);
+    std::nth_element(sorted, sorted + 31, sorted + 63);
+    float median = sorted[31];
+
+    uint64_t hash = 0;
+    for (int i = 0; i < hash_size * hash_size; ++i) {
+        if (coefficients[i] > median) hash |= 1ULL << i;
+    }
+    return hash;
+}
+
+void NearDuplicateCache::configure(size_t max_entries, int max_distance, int max_visits) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_entries_ = max_entries;
+    max_distance_ = std::max(0, std::min(max_distance, 64));
+    max_visits_ = max_visits > 0 ? max_visits : 2048;
+    entries_.clear();
+    entries_.shrink_to_fit();
+    nodes_.clear();
+    next_entry_ = 0;
+    dead_nodes_ = 0;
+}
+
+bool NearDuplicateCache::lookup(uint64_t hash, uint64_t model_id, std::vector<std::tuple<std::array<float, 4>, float, int>>& detections, std::vector<int>& stack) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int best_entry = -1;
+    int best_distance = max_distance_ + 1;
+
+    // Depth-first search; by the triangle inequality only children at distance d +- max_distance can hold matches.
+    stack.clear();
+    if (!nodes_.empty()) stack.push_back(0);
+    int visits = 0;
+    while (!stack.empty() && visits < max_visits_ && best_distance > 0) {
+        const Node& node = nodes_[stack.back()];
+        stack.pop_back();
+        ++visits;
+
+        int distance = hamming(hash, node.hash);
+        if (node.entry >= 0 && distance < best_distance && entries_[node.entry].model_id == model_id) {
+            best_distance = distance;
+            best_entry = node.entry;
+        }
+        for (const auto& child : node.children) {
+            if (std::abs(child.first - distance) <= max_distance_) stack.push_back(child.second);
+        }
+    }
+
+    if (best_entry < 0) {
+        ++misses_;
+        return false;
+    }
+    ++hits_;
+    detections = entries_[best_entry].detections;
+    return true;
+}
+
+void NearDuplicateCache::insert(uint64_t hash, uint64_t model_id, const std::vector<std::tuple<std::array<float, 4>, float, int>>& detections) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!max_entries_) return;
+
+    size_t slot = next_entry_;
+    next_entry_ = (next_entry_ + 1) % max_entries_;
+    if (slot == entries_.size()) {
+        entries_.emplace_back();
+    } else if (entries_[slot].live) {
+        // The overwritten entry's node stays in the tree (it still routes searches) but no longer matches.
+        nodes_[entries_[slot].node].entry = -1;
+        ++dead_nodes_;
+    }
+
+    Entry& entry = entries_[slot];
+    entry.hash = hash;
+    entry.model_id = model_id;
+    entry.live = true;
+    entry.detections = detections;
+    entry.node = add_node(hash, static_cast<int>(slot));
+
+    // Dead nodes lengthen searches; drop them once they outnumber the live ones.
+    if (dead_nodes_ > max_entries_) rebuild();
+}
+
+NearDuplicateCache::Stats NearDuplicateCache::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.bytes = nodes_.capacity() * sizeof(Node) + entries_.capacity() * sizeof(Entry);
+    for (const auto& entry : entries_) {
+        if (!entry.live) continue;
+        ++stats.entries;
+        stats.bytes += entry.detections.capacity() * sizeof(entry.detections[0]);
+    }
+    for (const auto& node : nodes_) stats.bytes += node.children.capacity() * sizeof(node.children[0]);
+    return stats;
+}
+
+int NearDuplicateCache::add_node(uint64_t hash, int entry) {
+    int index = static_cast<int>(nodes_.size());
+    if (nodes_.empty()) {
+        nodes_.push_back({hash, entry, {}});
+        return index;
+    }
+    int current = 0;
+    for (;;) {
+        int distance = hamming(hash, nodes_[current].hash);
+        if (distance == 0 && nodes_[current].entry < 0) {
+            // Same hash as a dead node: reuse it instead of growing the tree.
+            nodes_[current].entry = entry;
+            --dead_nodes_;
+            return current;
+        }
+        auto& children = nodes_[current].children;
+        auto child = std::find_if(children.begin(), children.end(), [&](const std::pair<int, int>& c) { return c.first == distance; });
+        if (child == children.end()) {
+            children.emplace_back(distance, index);
+            nodes_.push_back({hash, entry, {}});
+            return index;
+        }
+        current = child->second;
+    }
+}
+
+void NearDuplicateCache::rebuild() {
+    nodes_.clear();
+    dead_nodes_ = 0;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (entries_[i].live) entries_[i].node = add_node(entries_[i].hash, static_cast<int>(i));
+    }
+}
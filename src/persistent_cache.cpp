@@ -0,0 +1,205 @@
+#include "persistent_cache.h"
+#include "hash.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Atomics in the shared mapping are only meaningful across processes when they are lock-free (and so address-free).
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "64-bit atomics must be lock-free");
+
+namespace {
+    const uint64_t cache_magic = 0x3148434F4C4F59ULL;   // "YOLOCH1"
+    const uint32_t cache_version = 2;
+
+    struct StoredDetection {
+        float box[4];
+        float score;
+        int32_t class_id;
+    };
+}
+
+struct PersistentCache::Header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t max_detections;
+    uint64_t capacity;          // Power of two
+    uint64_t slot_size;
+    uint32_t hash_kind;         // HashKind of the content keys; another build's hash64 would never hit them
+    uint32_t reserved;
+    std::atomic<uint64_t> clock_hand;
+};
+
+// An even sequence means the slot is stable; a writer makes it odd for the duration of its update. Readers retry or
+// skip when the sequence is odd or changed while they copied the slot. A sequence of 0 marks a slot never written.
+struct PersistentCache::Slot {
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint32_t> referenced;   // Clock bit, set on every hit
+    uint32_t count;
+    uint64_t content;
+    uint64_t model;
+    uint64_t options;
+    StoredDetection detections[1];      // max_detections in the file
+};
+
+PersistentCache::~PersistentCache() {
+    if (map_) munmap(map_, map_size_);
+    if (fd_ >= 0) close(fd_);
+}
+
+bool PersistentCache::open(const char* path, size_t capacity, int max_detections) {
+    fd_ = ::open(path, O_RDWR | O_CREAT, 0664);
+    if (fd_ < 0) {
+        std::cerr << "Failed to open the persistent cache " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Only creation is serialised: the first process to take the lock sizes and initialises the file.
+    flock(fd_, LOCK_EX);
+    struct stat info {};
+    fstat(fd_, &info);
+    if (info.st_size == 0) {
+        uint64_t slots = 1;
+        while (slots < capacity) slots <<= 1;
+        max_detections = std::max(1, max_detections);
+        uint64_t slot_size = (sizeof(Slot) + (max_detections - 1) * sizeof(StoredDetection) + 63) & ~uint64_t(63);
+        size_t size = 4096 + slots * slot_size;
+        if (ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+            std::cerr << "Failed to size the persistent cache: " << std::strerror(errno) << std::endl;
+            flock(fd_, LOCK_UN);
+            return false;
+        }
+        Header header {};
+        header.magic = cache_magic;
+        header.version = cache_version;
+        header.max_detections = static_cast<uint32_t>(max_detections);
+        header.capacity = slots;
+        header.slot_size = slot_size;
+        header.hash_kind = hash64_kind();
+        if (pwrite(fd_, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+            flock(fd_, LOCK_UN);
+            return false;
+        }
+        info.st_size = static_cast<off_t>(size);
+    }
+    flock(fd_, LOCK_UN);
+
+    map_size_ = static_cast<size_t>(info.st_size);
+    map_ = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (map_ == MAP_FAILED) {
+        map_ = nullptr;
+        std::cerr << "Failed to map the persistent cache: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    // A damaged or foreign header must not send slot() or a detection copy outside the mapping.
+    Header* header = static_cast<Header*>(map_);
+    uint64_t min_slot_size = sizeof(Slot) + (std::max<uint32_t>(header->max_detections, 1) - 1) * sizeof(StoredDetection);
+    if (map_size_ < 4096 || header->magic != cache_magic || header->version != cache_version || header->max_detections == 0 ||
+        header->slot_size < min_slot_size || header->capacity == 0 || (header->capacity & (header->capacity - 1)) ||
+        header->capacity > (map_size_ - 4096) / header->slot_size) {
+        std::cerr << "Persistent cache " << path << " has an unknown format, delete it to recreate" << std::endl;
+        return false;
+    }
+    if (header->hash_kind != hash64_kind()) {
+        std::cerr << "Persistent cache " << path << " was written with " << (header->hash_kind == HASH_XXH3 ? "XXH3" : "XXH64")
+                  << " keys but this build hashes with " << (hash64_kind() == HASH_XXH3 ? "XXH3" : "XXH64")
+                  << ", delete it to recreate" << std::endl;
+        return false;
+    }
+    header_ = header;
+    return true;
+}
+
+PersistentCache::Slot* PersistentCache::slot(uint64_t index) const {
+    return reinterpret_cast<Slot*>(static_cast<char*>(map_) + 4096 + (index & (header_->capacity - 1)) * header_->slot_size);
+}
+
+bool PersistentCache::lookup(const ResultCacheKey& key, std::vector<std::tuple<std::array<float, 4>, float, int>>& detections) {
+    if (!header_) return false;
+    uint64_t home = ResultCacheKeyHash()(key);
+    std::vector<StoredDetection> copy(header_->max_detections);
+
+    for (int probe = 0; probe < probe_length; ++probe) {
+        Slot* s = slot(home + probe);
+        uint64_t before = s->sequence.load(std::memory_order_acquire);
+        if (before == 0 || (before & 1)) continue;
+        if (s->content != key.content || s->model != key.model || s->options != key.options) continue;
+
+        uint32_t count = std::min<uint32_t>(s->count, header_->max_detections);
+        std::memcpy(copy.data(), s->detections, count * sizeof(StoredDetection));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // Rewritten while copying (possibly with another key): treat as a miss rather than return torn data.
+        if (s->sequence.load(std::memory_order_relaxed) != before) break;
+
+        s->referenced.store(1, std::memory_order_relaxed);
+        detections.clear();
+        for (uint32_t i = 0; i < count; ++i) {
+            const StoredDetection& d = copy[i];
+            detections.emplace_back(std::array<float, 4>{d.box[0], d.box[1], d.box[2], d.box[3]}, d.score, d.class_id);
+        }
+        ++hits_;
+        return true;
+    }
+    ++misses_;
+    return false;
+}
+
+void PersistentCache::insert(const ResultCacheKey& key, const std::vector<std::tuple<std::array<float, 4>, float, int>>& detections) {
+    if (!header_ || detections.size() > header_->max_detections) return;
+    uint64_t home = ResultCacheKeyHash()(key);
+
+    // Prefer the slot already holding the key, then a never-used slot, then the clock victim. The clock hand is shared
+    // by all processes; slots it passes lose their referenced bit, so only entries not hit since the last sweep go.
+    int target = -1;
+    for (int probe = 0; probe < probe_length && target < 0; ++probe) {
+        Slot* s = slot(home + probe);
+        uint64_t sequence = s->sequence.load(std::memory_order_acquire);
+        if (sequence == 0 || (!(sequence & 1) && s->content == key.content && s->model == key.model && s->options == key.options)) {
+            target = probe;
+        }
+    }
+    for (int step = 0; step < 2 * probe_length && target < 0; ++step) {
+        int probe = static_cast<int>(header_->clock_hand.fetch_add(1, std::memory_order_relaxed) % probe_length);
+        if (slot(home + probe)->referenced.exchange(0, std::memory_order_relaxed) == 0) target = probe;
+    }
+    if (target < 0) target = 0;
+
+    Slot* s = slot(home + target);
+    uint64_t sequence = s->sequence.load(std::memory_order_acquire);
+    // Another writer owns the slot; dropping this insert is cheaper than waiting.
+    if ((sequence & 1) || !s->sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire)) return;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    s->content = key.content;
+    s->model = key.model;
+    s->options = key.options;
+    s->count = static_cast<uint32_t>(detections.size());
+    for (size_t i = 0; i < detections.size(); ++i) {
+        const auto& box = std::get<0>(detections[i]);
+        StoredDetection& d = s->detections[i];
+        std::copy(box.begin(), box.end(), d.box);
+        d.score = std::get<1>(detections[i]);
+        d.class_id = std::get<2>(detections[i]);
+    }
+    s->referenced.store(1, std::memory_order_relaxed);
+    s->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+PersistentCache::Stats PersistentCache::stats() const {
+    Stats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.bytes = map_size_;
+    if (header_) {
+        for (uint64_t i = 0; i < header_->capacity; ++i) {
+            if (slot(i)->sequence.load(std::memory_order_relaxed) != 0) ++stats.entries;
+        }
+    }
+    return stats;
+}
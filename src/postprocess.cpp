@@ -0,0 +1,144 @@
+#include "postprocess.h"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+// IoU used for NMS
+float iou(const std::array<float, 4>& box1, const std::array<float, 4>& box2) {
+    // Convert (x, y, w, h) to (x1, y1, x2, y2)
+    float x1_1 = box1[0];
+    float y1_1 = box1[1];
+    float x2_1 = box1[0] + box1[2];
+    float y2_1 = box1[1] + box1[3];
+
+    float x1_2 = box2[0];
+    float y1_2 = box2[1];
+    float x2_2 = box2[0] + box2[2];
+    float y2_2 = box2[1] + box2[3];
+
+    // Coordinates of the intersectional box
+    float inter_x1 = std::max(x1_1, x1_2);
+    float inter_y1 = std::max(y1_1, y1_2);
+    float inter_x2 = std::min(x2_1, x2_2);
+    float inter_y2 = std::min(y2_1, y2_2);
+
+    float inter_area = std::max(0.0f, inter_x2 - inter_x1) * std::max(0.0f, inter_y2 - inter_y1);
+    float box1_area = (x2_1 - x1_1) * (y2_1 - y1_1);
+    float box2_area = (x2_2 - x1_2) * (y2_2 - y1_2);
+
+    return inter_area / (box1_area + box2_area - inter_area);
+}
+
+void select_top_candidates(const std::vector<float>& scores, int max_candidates, std::vector<int>& order) {
+    order.resize(scores.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    auto by_score = [&scores](int i1, int i2) {
+        return scores[i1] > scores[i2];
+    };
+    if (max_candidates > 0 && static_cast<size_t>(max_candidates) < order.size()) {
+        std::nth_element(order.begin(), order.begin() + max_candidates, order.end(), by_score);
+        order.resize(max_candidates);
+    }
+    std::sort(order.begin(), order.end(), by_score);
+}
+
+// NMS function to filter model outputs.
+std::vector<int> apply_nms(
+    const std::vector<std::array<float, 4>>& boxes,
+    const std::vector<float>& scores,
+    const std::vector<int>& class_ids,
+    float score_threshold, float nms_threshold, int max_candidates
+) {
+    std::vector<int> order;
+    std::vector<unsigned char> suppressed;
+    std::vector<int> keep;
+    apply_nms(boxes, scores, class_ids, score_threshold, nms_threshold, max_candidates, order, suppressed, keep);
+    return keep;
+}
+
+void apply_nms(
+    const std::vector<std::array<float, 4>>& boxes,
+    const std::vector<float>& scores,
+    const std::vector<int>& class_ids,
+    float score_threshold, float nms_threshold, int max_candidates,
+    std::vector<int>& order, std::vector<unsigned char>& suppressed, std::vector<int>& keep
+) {
+    select_top_candidates(scores, max_candidates, order);
+
+    keep.clear();
+    suppressed.assign(boxes.size(), 0);
+
+    for (int i = 0; i < order.size(); ++i) {
+        int idx = order[i];
+        if (suppressed[idx] || scores[idx] < score_threshold) continue;
+        keep.push_back(idx);
+        for (int j = i + 1; j < order.size(); ++j) {
+            int next_idx = order[j];
+            if (!suppressed[next_idx] && iou(boxes[idx], boxes[next_idx]) > nms_threshold) {
+                suppressed[next_idx] = 1;
+            }
+        }
+    }
+}
+
+void find_best_classes(const float* predictions, int channels, int anchors, int begin, int end, float* best_scores, int* best_classes) {
+    // Predictions are channel-major ([4 + classes, anchors]), so walking one class row at a time keeps every read
+    // contiguous and lets the compiler vectorise the compare, instead of gathering 80 strided scores per anchor.
+    const float* first_class = predictions + 4 * static_cast<size_t>(anchors);
+    std::copy(first_class + begin, first_class + end, best_scores + begin);
+    std::fill(best_classes + begin, best_classes + end, 0);
+
+    for (int c = 1; c < channels - 4; ++c) {
+        const float* row = first_class + static_cast<size_t>(c) * anchors;
+        for (int a = begin; a < end; ++a) {
+            if (row[a] > best_scores[a]) {
+                best_scores[a] = row[a];
+                best_classes[a] = c;
+            }
+        }
+    }
+}
+
+void find_best_allowed_classes(
+    const float* predictions, int channels, int anchors, int begin, int end,
+    const int* classes, int class_count, float* best_scores, int* best_classes
+) {
+    // Same row-at-a-time scan as find_best_classes over the listed rows only, so asking for 2 of 80 classes reads
+    // 2 scores per anchor instead of 80.
+    const float* first_class = predictions + 4 * static_cast<size_t>(anchors);
+    std::fill(best_scores + begin, best_scores + end, -std::numeric_limits<float>::infinity());
+    std::fill(best_classes + begin, best_classes + end, -1);
+
+    for (int i = 0; i < class_count; ++i) {
+        int c = classes[i];
+        if (c < 0 || c >= channels - 4) continue;
+        const float* row = first_class + static_cast<size_t>(c) * anchors;
+        for (int a = begin; a < end; ++a) {
+            if (row[a] > best_scores[a]) {
+                best_scores[a] = row[a];
+                best_classes[a] = c;
+            }
+        }
+    }
+}
+
+void collect_candidates(
+    const float* predictions, int anchors, int begin, int end,
+    const float* best_scores, const int* best_classes, float score_threshold,
+    std::vector<std::array<float, 4>>& boxes, std::vector<float>& scores, std::vector<int>& class_ids
+) {
+    const float* cx = predictions;
+    const float* cy = predictions + anchors;
+    const float* w = predictions + 2 * static_cast<size_t>(anchors);
+    const float* h = predictions + 3 * static_cast<size_t>(anchors);
+
+    for (int a = begin; a < end; ++a) {
+        if (best_scores[a] >= score_threshold) {
+            // Centre (x, y, w, h) to top-left (x, y, w, h) as in outputs.ipynb.
+            boxes.push_back({cx[a] - 0.5f * w[a], cy[a] - 0.5f * h[a], w[a], h[a]});
+            scores.push_back(best_scores[a]);
+            class_ids.push_back(best_classes[a]);
+        }
+    }
+}
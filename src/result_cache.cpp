@@ -0,0 +1,63 @@
+#include "result_cache.h"
+
+namespace {
+    // Approximate footprint of an entry: payload plus list node, map node and vector headers.
+    size_t entry_bytes(const CachedResult& result) {
+        return result.detections.size() * sizeof(result.detections[0]) + result.output.size() + 128;
+    }
+}
+
+void ResultCache::configure(size_t max_bytes, bool store_output) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_bytes_ = max_bytes;
+    store_output_ = store_output;
+    evict_to(max_bytes);
+}
+
+bool ResultCache::lookup(const ResultCacheKey& key, CachedResult& result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = index_.find(key);
+    if (found == index_.end()) {
+        ++misses_;
+        return false;
+    }
+    entries_.splice(entries_.begin(), entries_, found->second);
+    result = found->second->result;
+    ++hits_;
+    return true;
+}
+
+void ResultCache::insert(const ResultCacheKey& key, CachedResult result) {
+    size_t bytes = entry_bytes(result);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (bytes > max_bytes_) return;
+
+    auto found = index_.find(key);
+    if (found != index_.end()) {
+        bytes_ -= found->second->bytes;
+        entries_.erase(found->second);
+        index_.erase(found);
+    }
+    evict_to(max_bytes_ - bytes);
+    entries_.push_front({key, std::move(result), bytes});
+    index_[key] = entries_.begin();
+    bytes_ += bytes;
+}
+
+ResultCache::Stats ResultCache::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.entries = entries_.size();
+    stats.bytes = bytes_;
+    return stats;
+}
+
+void ResultCache::evict_to(size_t max_bytes) {
+    while (bytes_ > max_bytes && !entries_.empty()) {
+        bytes_ -= entries_.back().bytes;
+        index_.erase(entries_.back().key);
+        entries_.pop_back();
+    }
+}
@@ -1,6 +1,11 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include "workspace.h"
+
+// Resizes given a ScratchArena as their context take their work memory from it (see resize_to_input)
+#define STBIR_MALLOC(size, context) ((context) ? static_cast<ScratchArena*>(context)->allocate(size) : malloc(size))
+#define STBIR_FREE(ptr, context) ((context) ? (void)0 : free(ptr))
 #define STB_IMAGE_RESIZE_IMPLEMENTATION
 #include <stb_image_resize.h>
 
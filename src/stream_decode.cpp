@@ -0,0 +1,294 @@
+#include "stream_decode.h"
+#include <csetjmp>
+#include <cstring>
+#include <iostream>
+#ifdef YOLO_HAVE_LIBJPEG
+#include <jpeglib.h>
+#endif
+#ifdef YOLO_HAVE_LIBPNG
+#include <png.h>
+#endif
+
+namespace {
+#if defined(YOLO_HAVE_LIBJPEG) || defined(YOLO_HAVE_LIBPNG)
+    bool has_signature(FILE* file, const unsigned char* signature, size_t length) {
+        unsigned char header[8];
+        size_t read = std::fread(header, 1, length, file);
+        std::rewind(file);
+        return read == length && std::memcmp(header, signature, length) == 0;
+    }
+#endif
+
+#ifdef YOLO_HAVE_LIBJPEG
+    // libjpeg's default error handler calls exit(); jump back to the caller instead.
+    struct JpegError {
+        jpeg_error_mgr manager;
+        std::jmp_buf jump;
+    };
+
+    void jpeg_error_exit(j_common_ptr info) {
+        char message[JMSG_LENGTH_MAX];
+        (*info->err->format_message)(info, message);
+        std::cerr << "JPEG error: " << message << std::endl;
+        std::longjmp(reinterpret_cast<JpegError*>(info->err)->jump, 1);
+    }
+
+    class JpegRowReader : public RowReader {
+    public:
+        ~JpegRowReader() override {
+            if (started_) jpeg_destroy_decompress(&info_);
+            if (file_) std::fclose(file_);
+        }
+
+        bool open(FILE* file, int scale_denom) {
+            file_ = file;
+            info_.err = jpeg_std_error(&error_.manager);
+            error_.manager.error_exit = jpeg_error_exit;
+            if (setjmp(error_.jump)) return false;
+
+            jpeg_create_decompress(&info_);
+            started_ = true;
+            jpeg_stdio_src(&info_, file_);
+            jpeg_read_header(&info_, TRUE);
+            info_.out_color_space = JCS_RGB;
+            info_.scale_num = 1;
+            info_.scale_denom = scale_denom;
+            jpeg_start_decompress(&info_);
+
+            width_ = info_.output_width;
+            height_ = info_.output_height;
+            return info_.output_components == 3;
+        }
+
+        bool read_row(unsigned char* rgb) override {
+            if (info_.output_scanline >= info_.output_height) return false;
+            if (setjmp(error_.jump)) return false;
+            JSAMPROW row = rgb;
+            return jpeg_read_scanlines(&info_, &row, 1) == 1;
+        }
+
+    private:
+        FILE* file_ = nullptr;
+        bool started_ = false;
+        jpeg_decompress_struct info_{};
+        JpegError error_{};
+    };
+#endif
+
+#ifdef YOLO_HAVE_LIBPNG
+    class PngRowReader : public RowReader {
+    public:
+        ~PngRowReader() override {
+            if (png_) png_destroy_read_struct(&png_, info_ ? &info_ : nullptr, nullptr);
+            if (file_) std::fclose(file_);
+        }
+
+        bool open(FILE* file) {
+            file_ = file;
+            png_ = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+            if (!png_) return false;
+            info_ = png_create_info_struct(png_);
+            if (!info_) return false;
+            if (setjmp(png_jmpbuf(png_))) return false;
+
+            png_init_io(png_, file_);
+            png_read_info(png_, info_);
+
+            // Interlaced PNGs need every pass before any row is final, which defeats streaming.
+            if (png_get_interlace_type(png_, info_) != PNG_INTERLACE_NONE) return false;
+
+            // Normalise every colour type to 8-bit RGB.
+            int color_type = png_get_color_type(png_, info_);
+            if (color_type == PNG_COLOR_TYPE_PALETTE) png_set_palette_to_rgb(png_);
+            if (color_type == PNG_COLOR_TYPE_GRAY && png_get_bit_depth(png_, info_) < 8) png_set_expand_gray_1_2_4_to_8(png_);
+            if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA) png_set_gray_to_rgb(png_);
+            if (png_get_valid(png_, info_, PNG_INFO_tRNS)) png_set_tRNS_to_alpha(png_);
+            png_set_strip_16(png_);
+            png_set_strip_alpha(png_);
+            png_read_update_info(png_, info_);
+
+            width_ = png_get_image_width(png_, info_);
+            height_ = png_get_image_height(png_, info_);
+            return png_get_rowbytes(png_, info_) == static_cast<size_t>(width_) * 3;
+        }
+
+        bool read_row(unsigned char* rgb) override {
+            if (row_ >= height_) return false;
+            if (setjmp(png_jmpbuf(png_))) return false;
+            png_read_row(png_, rgb, nullptr);
+            ++row_;
+            return true;
+        }
+
+    private:
+        FILE* file_ = nullptr;
+        png_structp png_ = nullptr;
+        png_infop info_ = nullptr;
+        int row_ = 0;
+    };
+#endif
+}
+
+std::unique_ptr<RowReader> open_row_reader(const char* path, int scale_denom) {
+    FILE* file = std::fopen(path, "rb");
+    if (!file) return nullptr;
+
+    const unsigned char jpeg_signature[] = {0xFF, 0xD8, 0xFF};
+    const unsigned char png_signature[] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+
+#ifdef YOLO_HAVE_LIBJPEG
+    if (has_signature(file, jpeg_signature, sizeof(jpeg_signature))) {
+        auto reader = std::make_unique<JpegRowReader>();
+        if (!reader->open(file, scale_denom)) return nullptr;
+        return reader;
+    }
+#endif
+#ifdef YOLO_HAVE_LIBPNG
+    if (has_signature(file, png_signature, sizeof(png_signature))) {
+        auto reader = std::make_unique<PngRowReader>();
+        if (!reader->open(file)) return nullptr;
+        return reader;
+    }
+#endif
+
+    (void)jpeg_signature;
+    (void)png_signature;
+    (void)scale_denom;
+    std::fclose(file);
+    return nullptr;
+}
+
+int jpeg_scale_denom(int width, int height, int min_width, int min_height) {
+    int denom = 1;
+    // libjpeg rounds scaled sizes up, so a plain division is a safe lower bound.
+    while (denom < 8 && width / (denom * 2) >= min_width && height / (denom * 2) >= min_height) denom *= 2;
+    return denom;
+}
+
+StreamingDownscaler::StreamingDownscaler(int src_width, int src_height, int dst_width, int dst_height)
+    : src_width_(src_width), src_height_(src_height), dst_width_(dst_width), dst_height_(dst_height),
+      column_map_(src_width), column_counts_(dst_width, 0),
+      accumulator_(static_cast<size_t>(dst_width) * 3, 0),
+      output_(static_cast<size_t>(dst_width) * dst_height * 3, 0) {
+    for (int x = 0; x < src_width; ++x) {
+        column_map_[x] = static_cast<int>(static_cast<int64_t>(x) * dst_width / src_width);
+        ++column_counts_[column_map_[x]];
+    }
+}
+
+void StreamingDownscaler::push_row(const unsigned char* rgb) {
+    if (src_row_ >= src_height_) return;
+
+    for (int x = 0; x < src_width_; ++x) {
+        uint32_t* sum = accumulator_.data() + column_map_[x] * 3;
+        sum[0] += rgb[x * 3];
+        sum[1] += rgb[x * 3 + 1];
+        sum[2] += rgb[x * 3 + 2];
+    }
+    ++rows_accumulated_;
+    ++src_row_;
+
+    // Source rows [y * dst_height / src_height] map to the same destination row; flush whenever the mapping advances.
+    // When upscaling (fewer source than destination rows) a source row is repeated into every row it covers.
+    int next_dst_row = src_row_ >= src_height_ ? dst_height_ : static_cast<int>(static_cast<int64_t>(src_row_) * dst_height_ / src_height_);
+    if (next_dst_row > dst_row_) {
+        int first = dst_row_;
+        flush_row();
+        while (dst_row_ < next_dst_row) {
+            std::memcpy(output_.data() + static_cast<size_t>(dst_row_) * dst_width_ * 3,
+                        output_.data() + static_cast<size_t>(first) * dst_width_ * 3, static_cast<size_t>(dst_width_) * 3);
+            ++dst_row_;
+        }
+    }
+}
+
+void StreamingDownscaler::flush_row() {
+    unsigned char* out = output_.data() + static_cast<size_t>(dst_row_) * dst_width_ * 3;
+    for (int x = 0; x < dst_width_; ++x) {
+        uint32_t count = static_cast<uint32_t>(column_counts_[x]) * rows_accumulated_;
+        for (int c = 0; c < 3; ++c) {
+            uint32_t& sum = accumulator_[x * 3 + c];
+            out[x * 3 + c] = count ? static_cast<unsigned char>((sum + count / 2) / count) : 0;
+            sum = 0;
+        }
+    }
+    // Upscaled columns that no source column maps to copy their left neighbour.
+    for (int x = 1; x < dst_width_; ++x) {
+        if (!column_counts_[x]) std::memcpy(out + x * 3, out + (x - 1) * 3, 3);
+    }
+    rows_accumulated_ = 0;
+    ++dst_row_;
+}
+
+#ifdef YOLO_HAVE_LIBJPEG
+struct JpegRowWriter::State {
+    FILE* file = nullptr;
+    bool started = false;
+    jpeg_compress_struct info{};
+    JpegError error{};
+};
+
+JpegRowWriter::JpegRowWriter() = default;
+
+JpegRowWriter::~JpegRowWriter() {
+    if (!state_) return;
+    if (state_->started) jpeg_destroy_compress(&state_->info);
+    if (state_->file) std::fclose(state_->file);
+}
+
+bool JpegRowWriter::open(const char* path, int width, int height, int quality) {
+    state_ = std::make_unique<State>();
+    state_->file = std::fopen(path, "wb");
+    if (!state_->file) return false;
+
+    jpeg_compress_struct& info = state_->info;
+    info.err = jpeg_std_error(&state_->error.manager);
+    state_->error.manager.error_exit = jpeg_error_exit;
+    if (setjmp(state_->error.jump)) return false;
+
+    jpeg_create_compress(&info);
+    state_->started = true;
+    jpeg_stdio_dest(&info, state_->file);
+    info.image_width = width;
+    info.image_height = height;
+    info.input_components = 3;
+    info.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&info);
+    jpeg_set_quality(&info, quality, TRUE);
+    jpeg_start_compress(&info, TRUE);
+    return true;
+}
+
+bool JpegRowWriter::write_row(const unsigned char* rgb) {
+    if (!state_ || !state_->started) return false;
+    if (setjmp(state_->error.jump)) return false;
+    JSAMPROW row = const_cast<unsigned char*>(rgb);
+    return jpeg_write_scanlines(&state_->info, &row, 1) == 1;
+}
+
+bool JpegRowWriter::close() {
+    if (!state_ || !state_->started) return false;
+    if (setjmp(state_->error.jump)) return false;
+    jpeg_finish_compress(&state_->info);
+    jpeg_destroy_compress(&state_->info);
+    state_->started = false;
+    bool ok = std::fclose(state_->file) == 0;
+    state_->file = nullptr;
+    return ok;
+}
+#else
+struct JpegRowWriter::State {};
+
+JpegRowWriter::JpegRowWriter() = default;
+
+JpegRowWriter::~JpegRowWriter() = default;
+
+bool JpegRowWriter::open(const char*, int, int, int) {
+    std::cerr << "Streaming JPEG output needs libjpeg (YOLO_HAVE_LIBJPEG)." << std::endl;
+    return false;
+}
+
+bool JpegRowWriter::write_row(const unsigned char*) { return false; }
+
+bool JpegRowWriter::close() { return false; }
+#endif
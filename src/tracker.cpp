@@ -0,0 +1,147 @@
+#include "tracker.h"
+#include "postprocess.h"
+#include <algorithm>
+
+namespace {
+    // Process and measurement noise scale with the box height, as in ByteTrack, so small and large objects are
+    // tracked with comparable relative uncertainty.
+    const float position_noise = 1.0f / 20.0f;
+    const float velocity_noise = 1.0f / 160.0f;
+
+    void predict_axis(KalmanAxis& axis, float scale) {
+        float q_position = position_noise * scale;
+        float q_velocity = velocity_noise * scale;
+        axis.position += axis.velocity;
+        // P = F P F' + Q with F = [[1, 1], [0, 1]]
+        axis.p00 += 2.0f * axis.p01 + axis.p11 + q_position * q_position;
+        axis.p01 += axis.p11;
+        axis.p11 += q_velocity * q_velocity;
+    }
+
+    void update_axis(KalmanAxis& axis, float measurement, float scale) {
+        float r = position_noise * scale;
+        float innovation = measurement - axis.position;
+        float s = axis.p00 + r * r;
+        float k0 = axis.p00 / s;
+        float k1 = axis.p01 / s;
+        axis.position += k0 * innovation;
+        axis.velocity += k1 * innovation;
+        // P = (I - K H) P with H = [1, 0]
+        float p00 = axis.p00, p01 = axis.p01;
+        axis.p00 -= k0 * p00;
+        axis.p01 -= k0 * p01;
+        axis.p11 -= k1 * p01;
+    }
+
+    std::array<float, 4> box_measurement(const std::array<float, 4>& box) {
+        return {box[0] + box[2] / 2, box[1] + box[3] / 2, box[2], box[3]};
+    }
+}
+
+std::array<float, 4> Track::box() const {
+    float w = std::max(0.0f, axes[2].position);
+    float h = std::max(0.0f, axes[3].position);
+    return {axes[0].position - w / 2, axes[1].position - h / 2, w, h};
+}
+
+Tracker::Tracker(const TrackerOptions& options) : options_(options) {}
+
+void Tracker::predict() {
+    for (auto& track : tracks_) {
+        float scale = std::max(1.0f, track.axes[3].position);
+        for (auto& axis : track.axes) predict_axis(axis, scale);
+        ++track.frames_since_update;
+        track.confidence *= options_.confidence_decay;
+    }
+}
+
+void Tracker::match(
+    const std::vector<std::tuple<std::array<float, 4>, float, int>>& detections, const std::vector<int>& candidates,
+    std::vector<bool>& track_matched, std::vector<bool>& detection_matched
+) {
+    // Greedy association by descending IoU; with the handful of objects per frame this matches the Hungarian result
+    // in practice at a fraction of the cost.
+    struct Pair { float overlap; int track; int detection; };
+    std::vector<Pair> pairs;
+    for (size_t t = 0; t < tracks_.size(); ++t) {
+        if (track_matched[t]) continue;
+        auto predicted = tracks_[t].box();
+        for (int d : candidates) {
+            if (detection_matched[d] || std::get<2>(detections[d]) != tracks_[t].class_id) continue;
+            float overlap = iou(predicted, std::get<0>(detections[d]));
+            if (overlap >= options_.match_iou) pairs.push_back({overlap, static_cast<int>(t), d});
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Pair& a, const Pair& b) { return a.overlap > b.overlap; });
+
+    for (const auto& pair : pairs) {
+        if (track_matched[pair.track] || detection_matched[pair.detection]) continue;
+        track_matched[pair.track] = true;
+        detection_matched[pair.detection] = true;
+
+        Track& track = tracks_[pair.track];
+        const auto& detection = detections[pair.detection];
+        auto measurement = box_measurement(std::get<0>(detection));
+        float scale = std::max(1.0f, measurement[3]);
+        for (int i = 0; i < 4; ++i) update_axis(track.axes[i], measurement[i], scale);
+        track.score = std::get<1>(detection);
+        track.confidence = track.score;
+        track.frames_since_update = 0;
+        track.lost = false;
+        ++track.hits;
+    }
+}
+
+void Tracker::update(const std::vector<std::tuple<std::array<float, 4>, float, int>>& detections) {
+    std::vector<int> high, low;
+    for (size_t d = 0; d < detections.size(); ++d) {
+        (std::get<1>(detections[d]) >= options_.high_threshold ? high : low).push_back(static_cast<int>(d));
+    }
+
+    std::vector<bool> track_matched(tracks_.size(), false);
+    std::vector<bool> detection_matched(detections.size(), false);
+    match(detections, high, track_matched, detection_matched);
+    // Low scoring detections are mostly occluded or blurred objects; they only keep existing tracks alive.
+    match(detections, low, track_matched, detection_matched);
+
+    for (size_t t = 0; t < tracks_.size(); ++t) {
+        if (!track_matched[t]) tracks_[t].lost = true;
+    }
+    tracks_.erase(std::remove_if(tracks_.begin(), tracks_.end(), [&](const Track& track) {
+        return track.lost && track.frames_since_update > options_.max_lost_frames;
+    }), tracks_.end());
+
+    for (int d : high) {
+        if (detection_matched[d]) continue;
+        Track track;
+        track.id = next_id_++;
+        track.class_id = std::get<2>(detections[d]);
+        track.score = track.confidence = std::get<1>(detections[d]);
+        track.hits = 1;
+        auto measurement = box_measurement(std::get<0>(detections[d]));
+        float scale = std::max(1.0f, measurement[3]);
+        for (int i = 0; i < 4; ++i) {
+            KalmanAxis& axis = track.axes[i];
+            axis.position = measurement[i];
+            axis.p00 = 4.0f * (position_noise * scale) * (position_noise * scale);
+            axis.p11 = 100.0f * (velocity_noise * scale) * (velocity_noise * scale);
+        }
+        tracks_.push_back(track);
+    }
+}
+
+std::vector<const Track*> Tracker::active_tracks() const {
+    std::vector<const Track*> active;
+    for (const auto& track : tracks_) {
+        if (!track.lost) active.push_back(&track);
+    }
+    return active;
+}
+
+float Tracker::min_confidence() const {
+    float lowest = 1.0f;
+    for (const auto& track : tracks_) {
+        if (!track.lost) lowest = std::min(lowest, track.confidence);
+    }
+    return lowest;
+}
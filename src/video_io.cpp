@@ -0,0 +1,399 @@
+#include "video_io.h"
+#include <algorithm>
+#include <iostream>
+#ifdef YOLO_WITH_FFMPEG
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+#endif
+
+#ifdef YOLO_WITH_FFMPEG
+namespace {
+    void print_av_error(const char* what, int error) {
+        char message[AV_ERROR_MAX_STRING_SIZE] = {};
+        av_strerror(error, message, sizeof(message));
+        std::cerr << what << ": " << message << std::endl;
+    }
+}
+
+struct VideoReader::State {
+    AVFormatContext* format = nullptr;
+    AVCodecContext* codec = nullptr;
+    AVFrame* frame = nullptr;
+    AVPacket* packet = nullptr;
+    SwsContext* model_scaler = nullptr;
+    SwsContext* full_scaler = nullptr;
+    int stream_index = -1;
+    double frame_rate = 0.0;
+    int model_width = 0;
+    int model_height = 0;
+    // Full frames keep the size the stream opened with; frames after a mid-stream resolution change are scaled to it.
+    int frame_width = 0;
+    int frame_height = 0;
+    int frame_stride = 1;
+    bool full_frames = false;
+
+    // Ring of preallocated frames: the decode thread takes from free_frames and hands over through ready_frames.
+    std::vector<VideoFrame> ring;
+    std::deque<VideoFrame*> free_frames;
+    std::deque<VideoFrame*> ready_frames;
+    std::mutex mutex;
+    std::condition_variable frame_freed;
+    std::condition_variable frame_ready;
+    bool finished = false;
+    std::atomic<bool> stop{false};
+    std::atomic<bool> failed{false};
+    std::thread thread;
+
+    ~State() {
+        if (thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            frame_freed.notify_all();
+            thread.join();
+        }
+        sws_freeContext(model_scaler);
+        sws_freeContext(full_scaler);
+        av_packet_free(&packet);
+        av_frame_free(&frame);
+        avcodec_free_context(&codec);
+        avformat_close_input(&format);
+    }
+
+    // Converts the decoded frame into a ring slot and queues it; false when the reader is being torn down.
+    bool deliver(long long index) {
+        VideoFrame* slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frame_freed.wait(lock, [&] { return stop || !free_frames.empty(); });
+            if (stop) return false;
+            slot = free_frames.front();
+            free_frames.pop_front();
+        }
+
+        AVRational time_base = format->streams[stream_index]->time_base;
+        int64_t pts = frame->best_effort_timestamp;
+        slot->index = index;
+        slot->timestamp_ms = pts == AV_NOPTS_VALUE ? index * 1000.0 / frame_rate : pts * av_q2d(time_base) * 1000.0;
+        slot->has_model_input = index % frame_stride == 0;
+
+        AVPixelFormat source_format = static_cast<AVPixelFormat>(frame->format);
+        if (slot->has_model_input) {
+            model_scaler = sws_getCachedContext(model_scaler, frame->width, frame->height, source_format,
+                                                model_width, model_height, AV_PIX_FMT_RGB24, SWS_AREA, nullptr, nullptr, nullptr);
+            uint8_t* planes[1] = {slot->model_input.data()};
+            int strides[1] = {model_width * 3};
+            sws_scale(model_scaler, frame->data, frame->linesize, 0, frame->height, planes, strides);
+        }
+        if (full_frames) {
+            full_scaler = sws_getCachedContext(full_scaler, frame->width, frame->height, source_format,
+                                               frame_width, frame_height, AV_PIX_FMT_RGB24, SWS_BILINEAR, nullptr, nullptr, nullptr);
+            uint8_t* planes[1] = {slot->rgb.data()};
+            int strides[1] = {frame_width * 3};
+            sws_scale(full_scaler, frame->data, frame->linesize, 0, frame->height, planes, strides);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready_frames.push_back(slot);
+        }
+        frame_ready.notify_one();
+        return true;
+    }
+
+    void decode() {
+        long long index = 0;
+        bool draining = false;
+        while (!stop) {
+            if (!draining) {
+                int result = av_read_frame(format, packet);
+                if (result < 0) {
+                    if (result != AVERROR_EOF) {
+                        print_av_error("Failed to read the video", result);
+                        failed = true;
+                    }
+                    // Flush the frames still buffered inside the decoder.
+                    draining = true;
+                    avcodec_send_packet(codec, nullptr);
+                } else if (packet->stream_index != stream_index) {
+                    av_packet_unref(packet);
+                    continue;
+                } else {
+                    result = avcodec_send_packet(codec, packet);
+                    av_packet_unref(packet);
+                    if (result < 0 && result != AVERROR(EAGAIN)) {
+                        print_av_error("Failed to decode the video", result);
+                        failed = true;
+                        break;
+                    }
+                }
+            }
+
+            int result;
+            while ((result = avcodec_receive_frame(codec, frame)) == 0) {
+                bool delivered = deliver(index++);
+                av_frame_unref(frame);
+                if (!delivered) break;
+            }
+            if (result == AVERROR_EOF) break;
+            if (result < 0 && result != AVERROR(EAGAIN)) {
+                print_av_error("Failed to decode the video", result);
+                failed = true;
+                break;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+        }
+        frame_ready.notify_all();
+    }
+};
+
+VideoReader::VideoReader() = default;
+
+VideoReader::~VideoReader() = default;
+
+bool VideoReader::open(const char* path, int model_width, int model_height, int ring_size, int frame_stride, bool full_frames) {
+    state_ = std::make_unique<State>();
+    State& s = *state_;
+    s.model_width = model_width;
+    s.model_height = model_height;
+    s.frame_stride = std::max(1, frame_stride);
+    s.full_frames = full_frames;
+
+    int result = avformat_open_input(&s.format, path, nullptr, nullptr);
+    if (result < 0) {
+        print_av_error("Failed to open the video", result);
+        return false;
+    }
+    if ((result = avformat_find_stream_info(s.format, nullptr)) < 0) {
+        print_av_error("Failed to read the video stream info", result);
+        return false;
+    }
+
+    const AVCodec* decoder = nullptr;
+    s.stream_index = av_find_best_stream(s.format, AVMEDIA_TYPE_VIDEO, -1, -1, &decoder, 0);
+    if (s.stream_index < 0 || !decoder) {
+        std::cerr << "No decodable video stream in " << path << std::endl;
+        return false;
+    }
+    AVStream* stream = s.format->streams[s.stream_index];
+
+    s.codec = avcodec_alloc_context3(decoder);
+    avcodec_parameters_to_context(s.codec, stream->codecpar);
+    // Let the decoder use its own frame/slice threads; the detector runs on the caller's thread.
+    s.codec->thread_count = 0;
+    if ((result = avcodec_open2(s.codec, decoder, nullptr)) < 0) {
+        print_av_error("Failed to open the video decoder", result);
+        return false;
+    }
+
+    AVRational rate = av_guess_frame_rate(s.format, stream, nullptr);
+    s.frame_rate = rate.num && rate.den ? av_q2d(rate) : 25.0;
+    s.frame = av_frame_alloc();
+    s.packet = av_packet_alloc();
+
+    s.frame_width = s.codec->width;
+    s.frame_height = s.codec->height;
+    s.ring.resize(std::max(2, ring_size));
+    for (auto& slot : s.ring) {
+        slot.model_input.resize(static_cast<size_t>(model_width) * model_height * 3);
+        if (full_frames) slot.rgb.resize(static_cast<size_t>(s.frame_width) * s.frame_height * 3);
+        s.free_frames.push_back(&slot);
+    }
+
+    s.thread = std::thread([&s] { s.decode(); });
+    return true;
+}
+
+int VideoReader::width() const { return state_ ? state_->frame_width : 0; }
+
+int VideoReader::height() const { return state_ ? state_->frame_height : 0; }
+
+double VideoReader::frame_rate() const { return state_ ? state_->frame_rate : 0.0; }
+
+VideoFrame* VideoReader::next() {
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    state_->frame_ready.wait(lock, [&] { return state_->finished || !state_->ready_frames.empty(); });
+    if (state_->ready_frames.empty()) return nullptr;
+    VideoFrame* frame = state_->ready_frames.front();
+    state_->ready_frames.pop_front();
+    return frame;
+}
+
+void VideoReader::release(VideoFrame* frame) {
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->free_frames.push_back(frame);
+    }
+    state_->frame_freed.notify_one();
+}
+
+bool VideoReader::failed() const { return state_ && state_->failed; }
+
+struct VideoWriter::State {
+    AVFormatContext* format = nullptr;
+    AVCodecContext* codec = nullptr;
+    AVStream* stream = nullptr;
+    AVFrame* frame = nullptr;
+    AVPacket* packet = nullptr;
+    SwsContext* scaler = nullptr;
+    int64_t next_pts = 0;
+    bool header_written = false;
+
+    ~State() {
+        sws_freeContext(scaler);
+        av_packet_free(&packet);
+        av_frame_free(&frame);
+        avcodec_free_context(&codec);
+        if (format) {
+            if (!(format->oformat->flags & AVFMT_NOFILE)) avio_closep(&format->pb);
+            avformat_free_context(format);
+        }
+    }
+
+    // Sends a frame (nullptr flushes) and writes every packet the encoder has ready.
+    bool encode(AVFrame* input) {
+        int result = avcodec_send_frame(codec, input);
+        if (result < 0) {
+            print_av_error("Failed to encode the video", result);
+            return false;
+        }
+        while ((result = avcodec_receive_packet(codec, packet)) == 0) {
+            av_packet_rescale_ts(packet, codec->time_base, stream->time_base);
+            packet->stream_index = stream->index;
+            result = av_interleaved_write_frame(format, packet);
+            if (result < 0) {
+                print_av_error("Failed to write the video", result);
+                return false;
+            }
+        }
+        return result == AVERROR(EAGAIN) || result == AVERROR_EOF;
+    }
+};
+
+VideoWriter::VideoWriter() = default;
+
+VideoWriter::~VideoWriter() = default;
+
+bool VideoWriter::open(const char* path, int width, int height, double frame_rate) {
+    state_ = std::make_unique<State>();
+    State& s = *state_;
+
+    int result = avformat_alloc_output_context2(&s.format, nullptr, nullptr, path);
+    if (result < 0 || !s.format) {
+        print_av_error("Unknown output video format", result);
+        return false;
+    }
+    const AVCodec* encoder = avcodec_find_encoder(s.format->oformat->video_codec);
+    if (!encoder) {
+        std::cerr << "No encoder for the output video format" << std::endl;
+        return false;
+    }
+
+    s.stream = avformat_new_stream(s.format, nullptr);
+    s.codec = avcodec_alloc_context3(encoder);
+    s.codec->width = width;
+    s.codec->height = height;
+    s.codec->pix_fmt = AV_PIX_FMT_YUV420P;
+    s.codec->framerate = av_d2q(frame_rate, 100000);
+    s.codec->time_base = av_inv_q(s.codec->framerate);
+    s.codec->thread_count = 0;
+    if (s.format->oformat->flags & AVFMT_GLOBALHEADER) s.codec->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    if ((result = avcodec_open2(s.codec, encoder, nullptr)) < 0) {
+        print_av_error("Failed to open the video encoder", result);
+        return false;
+    }
+    avcodec_parameters_from_context(s.stream->codecpar, s.codec);
+    s.stream->time_base = s.codec->time_base;
+
+    if (!(s.format->oformat->flags & AVFMT_NOFILE) && (result = avio_open(&s.format->pb, path, AVIO_FLAG_WRITE)) < 0) {
+        print_av_error("Failed to create the output video", result);
+        return false;
+    }
+    if ((result = avformat_write_header(s.format, nullptr)) < 0) {
+        print_av_error("Failed to write the video header", result);
+        return false;
+    }
+    s.header_written = true;
+
+    s.frame = av_frame_alloc();
+    s.frame->format = s.codec->pix_fmt;
+    s.frame->width = width;
+    s.frame->height = height;
+    if (av_frame_get_buffer(s.frame, 0) < 0) return false;
+    s.packet = av_packet_alloc();
+    s.scaler = sws_getContext(width, height, AV_PIX_FMT_RGB24, width, height, s.codec->pix_fmt, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    return s.scaler != nullptr;
+}
+
+bool VideoWriter::write(const unsigned char* rgb) {
+    if (!state_ || !state_->header_written) return false;
+    State& s = *state_;
+    if (av_frame_make_writable(s.frame) < 0) return false;
+
+    const uint8_t* planes[1] = {rgb};
+    int strides[1] = {s.codec->width * 3};
+    sws_scale(s.scaler, planes, strides, 0, s.codec->height, s.frame->data, s.frame->linesize);
+    s.frame->pts = s.next_pts++;
+    return s.encode(s.frame);
+}
+
+bool VideoWriter::close() {
+    if (!state_ || !state_->header_written) return false;
+    bool ok = state_->encode(nullptr);
+    ok = av_write_trailer(state_->format) == 0 && ok;
+    state_.reset();
+    return ok;
+}
+#else
+struct VideoReader::State {};
+
+VideoReader::VideoReader() = default;
+
+VideoReader::~VideoReader() = default;
+
+bool VideoReader::open(const char*, int, int, int, int, bool) {
+    std::cerr << "Video input needs libavformat/libavcodec (build with -DYOLO_WITH_FFMPEG=ON)." << std::endl;
+    return false;
+}
+
+int VideoReader::width() const { return 0; }
+
+int VideoReader::height() const { return 0; }
+
+double VideoReader::frame_rate() const { return 0.0; }
+
+VideoFrame* VideoReader::next() { return nullptr; }
+
+void VideoReader::release(VideoFrame*) {}
+
+bool VideoReader::failed() const { return true; }
+
+struct VideoWriter::State {};
+
+VideoWriter::VideoWriter() = default;
+
+VideoWriter::~VideoWriter() = default;
+
+bool VideoWriter::open(const char*, int, int, double) {
+    std::cerr << "Video output needs libavformat/libavcodec (build with -DYOLO_WITH_FFMPEG=ON)." << std::endl;
+    return false;
+}
+
+bool VideoWriter::write(const unsigned char*) { return false; }
+
+bool VideoWriter::close() { return false; }
+#endif
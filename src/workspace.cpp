@@ -0,0 +1,52 @@
+#include "workspace.h"
+#include <algorithm>
+
+namespace {
+    const size_t arena_alignment = 64;
+
+    char* allocate_block(size_t size) {
+        return static_cast<char*>(::operator new(size, std::align_val_t(arena_alignment)));
+    }
+
+    void free_block(char* data) {
+        if (data) ::operator delete(data, std::align_val_t(arena_alignment));
+    }
+}
+
+ScratchArena::~ScratchArena() {
+    free_block(current_.data);
+    for (const Block& block : retired_) free_block(block.data);
+}
+
+void* ScratchArena::allocate(size_t size) {
+    size = (size + arena_alignment - 1) & ~(arena_alignment - 1);
+    if (used_ + size > current_.size) {
+        if (current_.data) retired_.push_back(current_);
+        size_t block_size = std::max(size, 2 * current_.size);
+        current_ = {allocate_block(block_size), block_size};
+        used_ = 0;
+    }
+    void* result = current_.data + used_;
+    used_ += size;
+    return result;
+}
+
+void ScratchArena::reset() {
+    if (!retired_.empty()) {
+        size_t total = current_.size;
+        for (const Block& block : retired_) {
+            total += block.size;
+            free_block(block.data);
+        }
+        retired_.clear();
+        free_block(current_.data);
+        current_ = {allocate_block(total), total};
+    }
+    used_ = 0;
+}
+
+size_t ScratchArena::capacity() const {
+    size_t total = current_.size;
+    for (const Block& block : retired_) total += block.size;
+    return total;
+}
@@ -0,0 +1,394 @@
+// Batch detection over many images without PHP in the loop:
+//
+//   yolo_batch MODEL INPUT... [--batch N] [--threads N] [--io-depth N] [--jsonl FILE] [--output DIR]
+//
+// Each INPUT is a directory (its images, not recursive), a glob pattern (quoted so the shell leaves it alone), @FILE
+// listing one path per line (@- reads stdin) or a single image. Files are read ahead (io-depth at a time, through
+// io_uring where available), decoded from memory on a thread pool, run through the model N at a time, and written out
+// as they finish: one JSON line per image on stdout (or FILE) and, with --output, an annotated JPEG per image written
+// in the background. Only a few batches of images are in memory at any time.
+#include "yolov8.h"
+#include "async_io.h"
+#include "labels.h"
+#include <stb_image.h>
+#include <stb_image_resize.h>
+#include <stb_image_write.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glob.h>
+
+namespace {
+    const int model_size = 640;
+
+    struct Options {
+        std::string model_path;
+        std::vector<std::string> inputs;
+        int batch_size = 8;
+        int threads = 0;                // 0 = one per core
+        int io_depth = 32;              // Files read or written concurrently
+        std::string jsonl_path;         // Empty = stdout
+        std::string output_dir;         // Empty = no annotated images
+    };
+
+    struct Image {
+        size_t index = 0;
+        std::string path;
+        std::string error;              // Set when the image could not be read
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> model_input;     // 640x640 RGB
+        unsigned char* rgb = nullptr;               // Full image, only kept for annotation
+        std::vector<YOLOv8Detection> detections;
+    };
+
+    // Blocking producer/consumer queue with a fixed capacity, which is what bounds memory use.
+    template <typename T>
+    class BoundedQueue {
+    public:
+        explicit BoundedQueue(size_t capacity) : capacity_(capacity) {}
+
+        void push(T item) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_full_.wait(lock, [this] { return items_.size() < capacity_; });
+            items_.push_back(std::move(item));
+            not_empty_.notify_one();
+        }
+
+        // False once the queue is closed and drained.
+        bool pop(T& item) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock, [this] { return !items_.empty() || closed_; });
+            if (items_.empty()) return false;
+            item = std::move(items_.front());
+            items_.pop_front();
+            not_full_.notify_one();
+            return true;
+        }
+
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            not_empty_.notify_all();
+        }
+
+    private:
+        size_t capacity_;
+        std::deque<T> items_;
+        bool closed_ = false;
+        std::mutex mutex_;
+        std::condition_variable not_full_;
+        std::condition_variable not_empty_;
+    };
+
+    void print_usage() {
+        std::cerr << "Usage: yolo_batch MODEL INPUT... [--batch N] [--threads N] [--io-depth N] [--jsonl FILE] [--output DIR]\n"
+                     "  INPUT is a directory, a quoted glob pattern, @FILE with one path per line (@- for stdin) or an image.\n";
+    }
+
+    bool parse_options(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+            if (arg == "--batch" && has_value) options.batch_size = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--threads" && has_value) options.threads = std::max(0, std::atoi(argv[++i]));
+            else if (arg == "--io-depth" && has_value) options.io_depth = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--jsonl" && has_value) options.jsonl_path = argv[++i];
+            else if (arg == "--output" && has_value) options.output_dir = argv[++i];
+            else if (arg.compare(0, 2, "--") == 0) return false;
+            else if (options.model_path.empty()) options.model_path = arg;
+            else options.inputs.push_back(arg);
+        }
+        return !options.model_path.empty() && !options.inputs.empty();
+    }
+
+    bool is_image(const std::filesystem::path& path) {
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+        return extension == ".jpg" || extension == ".jpeg" || extension == ".png" || extension == ".bmp" ||
+               extension == ".tga" || extension == ".gif" || extension == ".pnm" || extension == ".ppm";
+    }
+
+    // Expands the INPUT arguments into image paths. Only the paths are held, never the images.
+    bool collect_paths(const std::vector<std::string>& inputs, std::vector<std::string>& paths) {
+        for (const auto& input : inputs) {
+            if (input[0] == '@') {
+                std::ifstream file;
+                if (input != "@-") {
+                    file.open(input.substr(1));
+                    if (!file) {
+                        std::cerr << "Failed to open the file list " << input.substr(1) << std::endl;
+                        return false;
+                    }
+                }
+                std::istream& list = input == "@-" ? std::cin : file;
+                for (std::string line; std::getline(list, line);) {
+                    if (!line.empty() && line.back() == '\r') line.pop_back();
+                    if (!line.empty()) paths.push_back(line);
+                }
+            } else if (std::filesystem::is_directory(input)) {
+                std::vector<std::string> entries;
+                for (const auto& entry : std::filesystem::directory_iterator(input)) {
+                    if (entry.is_regular_file() && is_image(entry.path())) entries.push_back(entry.path().string());
+                }
+                std::sort(entries.begin(), entries.end());
+                paths.insert(paths.end(), entries.begin(), entries.end());
+            } else if (input.find_first_of("*?[") != std::string::npos) {
+                glob_t matches {};
+                if (glob(input.c_str(), 0, nullptr, &matches) == 0) {
+                    for (size_t i = 0; i < matches.gl_pathc; ++i) paths.push_back(matches.gl_pathv[i]);
+                }
+                globfree(&matches);
+            } else {
+                paths.push_back(input);
+            }
+        }
+        return true;
+    }
+
+    // Decodes a prefetched file and resizes it to the model input. The full image is kept only when it is to be
+    // annotated.
+    void decode_image(Image& image, const FileData& file, bool keep_rgb) {
+        if (file.error) {
+            image.error = std::string("cannot read file: ") + std::strerror(file.error);
+            return;
+        }
+        int channels;
+        unsigned char* rgb = stbi_load_from_memory(file.bytes.data(), static_cast<int>(file.bytes.size()), &image.width, &image.height, &channels, 3);
+        if (!rgb) {
+            image.error = "cannot decode image";
+            return;
+        }
+        image.model_input.resize(static_cast<size_t>(model_size) * model_size * 3);
+        if (!stbir_resize_uint8(rgb, image.width, image.height, 0, image.model_input.data(), model_size, model_size, 0, 3)) {
+            image.error = "cannot resize image";
+            stbi_image_free(rgb);
+            return;
+        }
+        if (keep_rgb) image.rgb = rgb;
+        else stbi_image_free(rgb);
+    }
+
+    void write_json_string(std::string& out, const std::string& value) {
+        out += '"';
+        for (unsigned char c : value) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += static_cast<char>(c);
+            } else if (c < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += static_cast<char>(c);
+            }
+        }
+        out += '"';
+    }
+
+    // {"path": ..., "width": ..., "height": ..., "detections": [{"class_id", "label", "score", "box": [x, y, w, h]}]}
+    std::string json_line(const Image& image) {
+        std::string line = "{\"path\":";
+        write_json_string(line, image.path);
+        if (!image.error.empty()) {
+            line += ",\"error\":";
+            write_json_string(line, image.error);
+            return line + "}\n";
+        }
+        char number[160];
+        std::snprintf(number, sizeof(number), ",\"width\":%d,\"height\":%d,\"detections\":[", image.width, image.height);
+        line += number;
+        for (size_t i = 0; i < image.detections.size(); ++i) {
+            const YOLOv8Detection& d = image.detections[i];
+            const char* label = d.class_id >= 0 && d.class_id < 80 ? COCO_CLASSES[d.class_id] : "";
+            std::snprintf(number, sizeof(number), "%s{\"class_id\":%d,\"label\":\"%s\",\"score\":%.4f,\"box\":[%.1f,%.1f,%.1f,%.1f]}",
+                          i ? "," : "", d.class_id, label, d.score, d.x, d.y, d.width, d.height);
+            line += number;
+        }
+        return line + "]}\n";
+    }
+
+    void collect_detections(void* user_data, int index, const YOLOv8Detection* detections, int count) {
+        auto* batch = static_cast<std::vector<Image>*>(user_data);
+        (*batch)[index].detections.assign(detections, detections + count);
+    }
+
+    void append_bytes(void* context, void* data, int size) {
+        auto* bytes = static_cast<std::vector<unsigned char>*>(context);
+        bytes->insert(bytes->end(), static_cast<unsigned char*>(data), static_cast<unsigned char*>(data) + size);
+    }
+
+    // Annotated images are named after their input; inputs from different directories with the same name overwrite
+    // one another. The JPEG is encoded in memory and handed to the writer, so encoders never wait on the disk.
+    void save_annotated(YOLOv8* model, Image& image, const std::string& output_dir, FileWriter& writer) {
+        draw_detections(model, image.rgb, image.width, image.height, image.detections.data(), static_cast<int>(image.detections.size()));
+        std::string output_path = (std::filesystem::path(output_dir) / std::filesystem::path(image.path).stem()).string() + ".jpg";
+        std::vector<unsigned char> encoded;
+        if (stbi_write_jpg_to_func(append_bytes, &encoded, image.width, image.height, 3, image.rgb, 90)) {
+            writer.write(output_path, std::move(encoded));
+        } else {
+            std::cerr << "Failed to encode " << output_path << std::endl;
+        }
+        stbi_image_free(image.rgb);
+        image.rgb = nullptr;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage();
+        return 2;
+    }
+
+    std::vector<std::string> paths;
+    if (!collect_paths(options.inputs, paths)) return 1;
+    if (paths.empty()) {
+        std::cerr << "No images found." << std::endl;
+        return 1;
+    }
+
+    bool annotate = !options.output_dir.empty();
+    if (annotate) {
+        std::error_code error;
+        std::filesystem::create_directories(options.output_dir, error);
+    }
+
+    std::FILE* jsonl = stdout;
+    if (!options.jsonl_path.empty()) {
+        jsonl = std::fopen(options.jsonl_path.c_str(), "w");
+        if (!jsonl) {
+            std::cerr << "Failed to open " << options.jsonl_path << std::endl;
+            return 1;
+        }
+    }
+    // The library reports progress on std::cout; keep stdout for JSON lines only.
+    std::cout.rdbuf(std::cerr.rdbuf());
+
+    YOLOv8* model = load_model(options.model_path.c_str());
+    if (!model) return 1;
+
+    int threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    int batch_size = options.batch_size;
+
+    // Decoders fill the queue a couple of batches ahead of the model; with --output, encoders drain annotated images
+    // behind it. Both queues are bounded, so a slow stage stalls the others instead of buffering the whole input.
+    BoundedQueue<Image> decoded(2 * batch_size);
+    BoundedQueue<Image> to_encode(2 * batch_size);
+    FilePrefetcher prefetcher;
+    prefetcher.start(paths, options.io_depth);
+    FileWriter writer;
+    if (annotate) writer.start(options.io_depth);
+    std::cerr << "Reading " << paths.size() << " images " << (prefetcher.uses_io_uring() ? "through io_uring" : "with blocking reads")
+              << ", " << options.io_depth << " at a time." << std::endl;
+    std::atomic<int> decoders_running{threads};
+
+    std::vector<std::thread> decoders;
+    for (int t = 0; t < threads; ++t) {
+        decoders.emplace_back([&] {
+            for (FileData file; prefetcher.next(file);) {
+                Image image;
+                image.index = file.index;
+                image.path = paths[file.index];
+                decode_image(image, file, annotate);
+                decoded.push(std::move(image));
+            }
+            if (--decoders_running == 0) decoded.close();
+        });
+    }
+
+    std::vector<std::thread> encoders;
+    if (annotate) {
+        for (int t = 0; t < std::max(1, threads / 2); ++t) {
+            encoders.emplace_back([&] {
+                for (Image image; to_encode.pop(image);) save_annotated(model, image, options.output_dir, writer);
+            });
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto last_report = start;
+    size_t done = 0;
+    size_t failed = 0;
+    bool inference_failed = false;
+
+    std::vector<Image> batch;
+    for (bool more = true; more && !inference_failed;) {
+        // Fill a whole batch unless the input runs out; images that failed to decode are reported straight away.
+        batch.clear();
+        Image image;
+        while (batch.size() < static_cast<size_t>(batch_size) && (more = decoded.pop(image))) {
+            if (image.error.empty()) {
+                batch.push_back(std::move(image));
+            } else {
+                std::fputs(json_line(image).c_str(), jsonl);
+                ++done;
+                ++failed;
+            }
+        }
+        if (batch.empty()) continue;
+
+        std::vector<const unsigned char*> inputs;
+        std::vector<int> widths;
+        std::vector<int> heights;
+        for (const auto& item : batch) {
+            inputs.push_back(item.model_input.data());
+            widths.push_back(item.width);
+            heights.push_back(item.height);
+        }
+        if (!detect_batch(model, inputs.data(), widths.data(), heights.data(), static_cast<int>(batch.size()), collect_detections, &batch)) {
+            inference_failed = true;
+        }
+
+        for (auto& item : batch) {
+            if (inference_failed) {
+                item.error = "inference failed";
+                ++failed;
+            }
+            std::fputs(json_line(item).c_str(), jsonl);
+            ++done;
+            if (item.rgb) {
+                if (inference_failed) stbi_image_free(item.rgb);
+                else to_encode.push(std::move(item));
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_report > std::chrono::seconds(5)) {
+            double seconds = std::chrono::duration<double>(now - start).count();
+            std::cerr << done << "/" << paths.size() << " images, " << done / seconds << " images/sec" << std::endl;
+            last_report = now;
+        }
+    }
+
+    // After an inference failure the decoders may be blocked on a full queue; stop them and drain it.
+    prefetcher.stop();
+    for (Image image; decoded.pop(image);) {
+        if (image.rgb) stbi_image_free(image.rgb);
+    }
+    for (auto& decoder : decoders) decoder.join();
+    to_encode.close();
+    for (auto& encoder : encoders) encoder.join();
+    size_t write_failures = writer.finish();
+    if (jsonl != stdout) std::fclose(jsonl);
+    else std::fflush(stdout);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Processed " << done << " images (" << failed << " failed) in " << seconds << " s: "
+              << (seconds > 0 ? done / seconds : 0.0) << " images/sec" << std::endl;
+    release_model(model);
+    return inference_failed || write_failures ? 1 : 0;
+}
@@ -0,0 +1,51 @@
+#include "postprocess.h"
+#include <torch/script.h>
+#include <ATen/Parallel.h>
+#include <algorithm>
+#include <vector>
+
+// yolo::decode_nms(Tensor predictions, float score_threshold, float iou_threshold, int max_detections) -> Tensor
+//
+// Runs the same decode and NMS as process_frame inside the TorchScript graph, so a model exported with
+// `modelExport.py --nms` returns a compact [K, 6] (x, y, w, h, score, class_id) tensor instead of the raw
+// [1, 84, 8400] predictions. The per-anchor argmax is split across libtorch's intra-op thread pool.
+at::Tensor decode_nms(const at::Tensor& predictions, double score_threshold, double iou_threshold, int64_t max_detections) {
+    TORCH_CHECK(predictions.dim() == 3 && predictions.size(0) == 1, "decode_nms expects [1, 4 + classes, anchors] predictions");
+    TORCH_CHECK(predictions.size(1) > 4, "decode_nms expects at least one class channel");
+
+    at::Tensor block = predictions[0].to(torch::kFloat).contiguous();
+    const float* data = block.data_ptr<float>();
+    int channels = block.size(0);
+    int anchors = block.size(1);
+
+    std::vector<float> best_scores(anchors);
+    std::vector<int> best_classes(anchors);
+    at::parallel_for(0, anchors, 1024, [&](int64_t begin, int64_t end) {
+        find_best_classes(data, channels, anchors, begin, end, best_scores.data(), best_classes.data());
+    });
+
+    std::vector<std::array<float, 4>> boxes;
+    std::vector<float> scores;
+    std::vector<int> class_ids;
+    collect_candidates(data, anchors, 0, anchors, best_scores.data(), best_classes.data(), score_threshold, boxes, scores, class_ids);
+
+    std::vector<int> keep = apply_nms(boxes, scores, class_ids, score_threshold, iou_threshold, default_max_candidates);
+    if (max_detections > 0 && static_cast<int64_t>(keep.size()) > max_detections) keep.resize(max_detections);
+
+    at::Tensor detections = torch::empty({static_cast<int64_t>(keep.size()), 6}, torch::kFloat);
+    float* out = detections.data_ptr<float>();
+    for (int idx : keep) {
+        out[0] = boxes[idx][0];
+        out[1] = boxes[idx][1];
+        out[2] = boxes[idx][2];
+        out[3] = boxes[idx][3];
+        out[4] = scores[idx];
+        out[5] = static_cast<float>(class_ids[idx]);
+        out += 6;
+    }
+    return detections;
+}
+
+TORCH_LIBRARY(yolo, m) {
+    m.def("decode_nms(Tensor predictions, float score_threshold, float iou_threshold, int max_detections) -> Tensor", &decode_nms);
+}
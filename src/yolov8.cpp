@@ -1,114 +1,694 @@
 #include "yolov8.h"
+#include "alloc_counter.h"
+#include "cpu_affinity.h"
+#include "hash.h"
+#include "labels.h"
+#include "motion_gate.h"
+#include "near_duplicate.h"
+#include "persistent_cache.h"
+#include "postprocess.h"
+#include "result_cache.h"
+#include "stream_decode.h"
+#include "tracker.h"
+#include "video_io.h"
+#include "workspace.h"
 #include <stb_image.h>
 #include <stb_image_resize.h>
 #include <stb_image_write.h>
 #include <torch/script.h>
+#include <ATen/Parallel.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef YOLO_WITH_ONNXRUNTIME
+#include <onnxruntime_cxx_api.h>
+#endif
+#ifdef YOLO_WITH_OPENVINO
+#include <openvino/openvino.hpp>
+#endif
 #include <iostream>
+#include <atomic>
+#include <fstream>
+#include <map>
 #include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <functional>
 #include <algorithm>
+#include <numeric>
+#include <cctype>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
 
 extern "C" {
-    struct YOLOv8 {
+    // Runs the network on a preprocessed [N, 3, H, W] float batch in [0, 1] and returns the raw
+    // [N, 84, anchors] float predictions. Preprocessing, decode and NMS are shared by every backend.
+    struct InferenceBackend {
+        virtual ~InferenceBackend() = default;
+        virtual at::Tensor forward(const at::Tensor& input) = 0;
+    };
+
+    struct TorchBackend : InferenceBackend {
         torch::jit::script::Module module;
+        at::ScalarType input_dtype = torch::kFloat;
+
+        at::Tensor forward(const at::Tensor& input) override {
+            std::vector<torch::jit::IValue> inputs;
+            inputs.push_back(input.to(input_dtype));
+            // Only the small output tensor is converted back for decoding when running in BF16.
+            return module.forward(inputs).toTensor().to(torch::kFloat);
+        }
     };
 
-    // Load model from torchscript file
-    YOLOv8* load_model(const char* model_path) {
-        YOLOv8* model = new YOLOv8();
-        try {
-            model->module = torch::jit::load(model_path);
-        } catch (const c10::Error& e) {
-            std::cerr << "Error loading the model: " << e.what() << std::endl;
-            delete model;
-            return nullptr;
+    // Process-wide thread counts and CPU sets, see set_thread_options.
+    struct ThreadConfig {
+        std::mutex mutex;
+        int intra_op_threads = 0;
+        int inter_op_threads = 0;
+        std::vector<int> inference_cpus;
+        std::vector<int> processing_cpus;
+        std::vector<int> initial_cpus;          // The first caller's CPUs, restored when a set is cleared
+        std::atomic<int> generation{0};         // Bumped by each set_thread_options so calling threads re-pin
+    };
+
+    ThreadConfig& thread_config() {
+        static ThreadConfig config;
+        return config;
+    }
+
+    std::vector<int> inference_cpus() {
+        ThreadConfig& config = thread_config();
+        std::lock_guard<std::mutex> lock(config.mutex);
+        return config.inference_cpus;
+    }
+
+    thread_local int pinned_generation = 0;
+    thread_local bool bound_to_node = false;    // NUMA replica workers keep their node's CPUs, see ModelReplica
+
+    // Moves a thread calling into the library onto the processing CPUs, once per set_thread_options call, so decoding,
+    // resizing, decode/NMS and drawing stay off the inference CPUs. Threads it starts (the video decoder) inherit them.
+    void pin_calling_thread() {
+        if (bound_to_node) return;
+        ThreadConfig& config = thread_config();
+        int generation = config.generation.load();
+        if (generation == pinned_generation) return;
+        pinned_generation = generation;
+
+        std::vector<int> cpus;
+        {
+            std::lock_guard<std::mutex> lock(config.mutex);
+            cpus = config.processing_cpus.empty() ? config.initial_cpus : config.processing_cpus;
         }
-        return model;
+        pin_thread(cpus);
+    }
+
+#ifdef YOLO_WITH_ONNXRUNTIME
+    std::atomic<bool> onnxruntime_started{false};
+
+    Ort::ThreadingOptions onnxruntime_threading() {
+        ThreadConfig& config = thread_config();
+        std::lock_guard<std::mutex> lock(config.mutex);
+        Ort::ThreadingOptions threading;
+        if (config.intra_op_threads > 0) threading.SetGlobalIntraOpNumThreads(config.intra_op_threads);
+        if (config.inter_op_threads > 0) threading.SetGlobalInterOpNumThreads(config.inter_op_threads);
+        return threading;
+    }
+
+    // One Ort::Env per process. Its global intra/inter-op thread pools are shared by every session, so several
+    // resident models (see register_model) do not each start a pool sized to the machine. The pools start with the
+    // first ONNX model, sized by set_thread_options and pinned to the inference CPUs by load_model_with_options.
+    Ort::Env& onnxruntime_env() {
+        static Ort::Env env(onnxruntime_threading(), ORT_LOGGING_LEVEL_WARNING, "yolov8");
+        onnxruntime_started = true;
+        return env;
+    }
+
+    struct OnnxRuntimeBackend : InferenceBackend {
+        std::unique_ptr<Ort::Session> session;
+        std::string input_name;
+        std::string output_name;
+        Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+
+        at::Tensor forward(const at::Tensor& input) override {
+            at::Tensor contiguous_input = input.to(torch::kFloat).contiguous();
+            std::vector<int64_t> input_shape(contiguous_input.sizes().begin(), contiguous_input.sizes().end());
+            Ort::Value input_value = Ort::Value::CreateTensor<float>(
+                memory_info, contiguous_input.data_ptr<float>(), contiguous_input.numel(), input_shape.data(), input_shape.size());
+
+            const char* input_names[] = {input_name.c_str()};
+            const char* output_names[] = {output_name.c_str()};
+            auto outputs = session->Run(Ort::RunOptions{nullptr}, input_names, &input_value, 1, output_names, 1);
+
+            // Hand ORT's output buffer to torch without copying; the tensor keeps the Ort::Value alive.
+            auto holder = std::make_shared<Ort::Value>(std::move(outputs[0]));
+            std::vector<int64_t> output_shape = holder->GetTensorTypeAndShapeInfo().GetShape();
+            return torch::from_blob(holder->GetTensorMutableData<float>(), output_shape, [holder](void*) {}, torch::kFloat);
+        }
+    };
+#endif
+
+#ifdef YOLO_WITH_OPENVINO
+    // One ov::Core per process so every compiled model shares the CPU plugin and its stream executors.
+    ov::Core& openvino_core() {
+        static ov::Core core;
+        return core;
+    }
+
+    // Each OpenVINO stream runs one infer request at a time, so the backend keeps a pool of requests and
+    // concurrent process_frame calls on the same handle each borrow one instead of serialising on a single request.
+    struct OpenVinoBackend : InferenceBackend {
+        ov::CompiledModel compiled_model;
+        std::vector<ov::InferRequest> requests;
+        std::vector<int> free_requests;
+        std::mutex mutex;
+        std::condition_variable request_released;
+
+        int acquire_request() {
+            std::unique_lock<std::mutex> lock(mutex);
+            request_released.wait(lock, [this] { return !free_requests.empty(); });
+            int index = free_requests.back();
+            free_requests.pop_back();
+            return index;
+        }
+
+        void release_request(int index) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                free_requests.push_back(index);
+            }
+            request_released.notify_one();
+        }
+
+        at::Tensor forward(const at::Tensor& input) override {
+            at::Tensor contiguous_input = input.to(torch::kFloat).contiguous();
+            ov::Shape input_shape(contiguous_input.sizes().begin(), contiguous_input.sizes().end());
+
+            int index = acquire_request();
+            try {
+                ov::InferRequest& request = requests[index];
+                request.set_input_tensor(ov::Tensor(ov::element::f32, input_shape, contiguous_input.data_ptr<float>()));
+                request.infer();
+
+                // The output lives in the request's buffer; the request goes back to the pool when torch frees the tensor.
+                ov::Tensor output = request.get_output_tensor();
+                std::vector<int64_t> output_shape(output.get_shape().begin(), output.get_shape().end());
+                return torch::from_blob(output.data<float>(), output_shape, [this, index](void*) { release_request(index); }, torch::kFloat);
+            } catch (...) {
+                release_request(index);
+                throw;
+            }
+        }
+    };
+#endif
+
+    // Buffers for one frame in flight, reused frame after frame: once they have grown to size, resizing, preprocessing,
+    // decode and NMS allocate nothing.
+    struct FrameWorkspace {
+        AlignedBuffer<unsigned char> resized;   // Square RGB model input
+        ScratchArena resize_arena;              // stb_image_resize's work memory
+        at::Tensor input;                       // [1, 3, size, size] float, filled in place
+        DecodeScratch decode;
+        std::vector<std::tuple<std::array<float, 4>, float, int>> detections;
+        ThumbnailScratch thumbnail;             // perceptual_hash's
+        std::vector<int> search_stack;          // Near-duplicate cache lookups'
+        std::vector<YOLOv8Detection> frame_detections;  // report_detections'
+        unsigned long long forward_allocations = 0;     // Made by detect's last forward pass, see frame_allocations
+
+        // Bytes held by the larger buffers, for get_model_stats.
+        size_t bytes() const {
+            return resized.capacity() + resize_arena.capacity() + (input.defined() ? input.nbytes() : 0) +
+                   decode.best_scores.capacity() * sizeof(float) + decode.best_classes.capacity() * sizeof(int) +
+                   decode.boxes.capacity() * sizeof(std::array<float, 4>);
+        }
+    };
+
+    // Resize + forward time at one input size, for requests with a latency budget.
+    struct SizeLatency {
+        double ms = 0.0;                // Moving average over the frames after the first
+        unsigned long long frames = 0;
+        bool rejected = false;          // The backend failed at this size (a fixed-shape export)
+    };
+
+    struct YOLOv8 {
+        std::unique_ptr<InferenceBackend> backend;
+        LabelRenderer labels;
+        int precision = YOLO_PRECISION_FP32;
+        uint64_t model_id = 0;          // Result cache key component, see model_identity
+        std::vector<int> class_map;     // COCO class id of each output channel of a class-pruned export, empty otherwise
+
+        // Startup and steady-state latency, reported by get_model_stats.
+        std::mutex stats_mutex;
+        double load_ms = 0.0;
+        size_t weight_bytes = 0;
+        double first_forward_ms = 0.0;
+        double total_forward_ms = 0.0;
+        unsigned long long frames = 0;
+        unsigned long long skipped_frames = 0;
+        std::map<int, SizeLatency> size_latency;    // By model input size, see choose_input_size
+
+        // Frames the motion gate finds unchanged reuse the previous detections instead of running forward.
+        std::mutex motion_mutex;
+        MotionGate motion_gate;
+        bool has_last_boxes = false;
+        uint64_t last_options = 0;      // options_identity of the request last_boxes came from
+        std::vector<std::tuple<std::array<float, 4>, float, int>> last_boxes;
+
+        // Inputs larger than this are rejected or streamed (0 = unlimited), see set_pixel_budget. Atomic since requests
+        // read them while set_pixel_budget may run; a request reads max_pixels once.
+        std::atomic<unsigned long long> max_pixels{0};
+        std::atomic<int> oversize_policy{YOLO_OVERSIZE_DOWNSAMPLE};
+
+        // Highest scoring candidates NMS considers per image (0 = all), see set_max_candidates. Atomic for the same
+        // reason as the pixel budget.
+        std::atomic<int> max_candidates{default_max_candidates};
+
+        // Set once a batched forward fails and a single-image one then succeeds (fixed batch of 1); detect_batch and
+        // tiled inference then run one image or tile per forward.
+        std::atomic<bool> batch_rejected{false};
+
+        // Workspaces not in use, one per concurrent call at most, see WorkspaceLease.
+        std::mutex workspace_mutex;
+        std::vector<std::unique_ptr<FrameWorkspace>> free_workspaces;
+
+        // Heap allocations of the last detect outside the backend's forward pass (YOLO_COUNT_ALLOCATIONS builds).
+        long long frame_allocations = -1;
+    };
+
+    // Borrows a workspace from the handle for the duration of a call, creating one when every workspace is taken.
+    class WorkspaceLease {
+    public:
+        explicit WorkspaceLease(YOLOv8* model) : model_(model) {
+            std::lock_guard<std::mutex> lock(model->workspace_mutex);
+            if (model->free_workspaces.empty()) {
+                workspace_ = std::make_unique<FrameWorkspace>();
+            } else {
+                workspace_ = std::move(model->free_workspaces.back());
+                model->free_workspaces.pop_back();
+            }
+        }
+
+        ~WorkspaceLease() {
+            std::lock_guard<std::mutex> lock(model_->workspace_mutex);
+            model_->free_workspaces.push_back(std::move(workspace_));
+        }
+
+        WorkspaceLease(const WorkspaceLease&) = delete;
+        WorkspaceLease& operator=(const WorkspaceLease&) = delete;
+
+        FrameWorkspace& operator*() const { return *workspace_; }
+        FrameWorkspace* operator->() const { return workspace_.get(); }
+
+    private:
+        YOLOv8* model_;
+        std::unique_ptr<FrameWorkspace> workspace_;
+    };
+
+    // Reads a string value from the JSON metadata stored alongside the module (config.txt), "" if absent.
+    std::string read_config_value(const std::string& config, const std::string& key) {
+        size_t pos = config.find("\"" + key + "\"");
+        if (pos == std::string::npos) return "";
+        pos = config.find(':', pos);
+        if (pos == std::string::npos) return "";
+        size_t start = config.find('"', pos);
+        size_t end = start == std::string::npos ? std::string::npos : config.find('"', start + 1);
+        if (end == std::string::npos) return "";
+        return config.substr(start + 1, end - start - 1);
+    }
+
+    // The text of a list value ("[0, 2]") in the same metadata, "" if absent.
+    std::string read_config_list(const std::string& config, const std::string& key) {
+        size_t pos = config.find("\"" + key + "\"");
+        if (pos == std::string::npos) return "";
+        size_t start = config.find('[', pos);
+        size_t end = start == std::string::npos ? std::string::npos : config.find(']', start);
+        if (end == std::string::npos) return "";
+        return config.substr(start, end - start + 1);
+    }
+
+    // Class-pruned exports (modelExport.py --classes) list the COCO id behind each of their class channels, e.g.
+    // "[0, 2]" for a person/car head. Returns an empty map for anything else.
+    std::vector<int> parse_class_list(const std::string& text) {
+        std::vector<int> classes;
+        for (size_t pos = 0; (pos = text.find_first_of("0123456789", pos)) != std::string::npos;) {
+            size_t end = text.find_first_not_of("0123456789", pos);
+            int class_id = std::stoi(text.substr(pos, end - pos));
+            if (class_id >= 80) return {};
+            classes.push_back(class_id);
+            pos = end;
+        }
+        return classes;
+    }
+
+    // INT8 exports from modelExport.py record the quantized engine they were calibrated for; it has to be the
+    // active engine before forward or the quantized conv/linear ops will not find packed weights.
+    bool select_quantized_engine(const std::string& qengine) {
+        if (qengine.empty()) return true;
+
+        at::QEngine engine;
+        if (qengine == "x86") engine = at::QEngine::X86;
+        else if (qengine == "fbgemm") engine = at::QEngine::FBGEMM;
+        else if (qengine == "onednn") engine = at::QEngine::ONEDNN;
+        else if (qengine == "qnnpack") engine = at::QEngine::QNNPACK;
+        else {
+            std::cerr << "Unknown quantized engine in model metadata: " << qengine << std::endl;
+            return false;
+        }
+
+        const auto& supported = at::globalContext().supportedQEngines();
+        if (std::find(supported.begin(), supported.end(), engine) == supported.end()) {
+            std::cerr << "Quantized engine " << qengine << " is not supported by this libtorch build" << std::endl;
+            return false;
+        }
+
+        at::globalContext().setQEngine(engine);
+        std::cout << "Quantized model, using " << qengine << " engine." << std::endl;
+        return true;
+    }
+
+    // True when the CPU (and OS) can run bfloat16 matmul/conv natively: AVX512-BF16 or AMX-BF16.
+    bool cpu_supports_bf16() {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE)) return false;
+
+        // The OS must save the AVX-512 opmask/ZMM state (XCR0 bits 1, 2, 5, 6, 7), and for AMX also the tile
+        // configuration and data (bits 17, 18). Linux additionally grants tile data per process through
+        // arch_prctl(ARCH_REQ_XCOMP_PERM), which oneDNN requests itself before its first AMX kernel.
+        unsigned int xcr0_lo, xcr0_hi;
+        __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        bool avx512_state = (xcr0_lo & 0xE6) == 0xE6;
+        bool amx_state = (xcr0_lo & (3u << 17)) == (3u << 17);
+
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+        bool amx_bf16 = (edx & (1u << 22)) && amx_state;
+        if (!__get_cpuid_count(7, 1, &eax, &ebx, &ecx, &edx)) return amx_bf16 && avx512_state;
+        bool avx512_bf16 = eax & (1u << 5);
+        return avx512_state && (avx512_bf16 || amx_bf16);
+#else
+        return false;
+#endif
+    }
+
+    void default_load_options(YOLOv8LoadOptions* options) {
+        options->precision = YOLO_PRECISION_FP32;
+        options->backend = YOLO_BACKEND_AUTO;
+        options->concurrency = 1;
+        options->numa_replicas = 0;
+    }
+
+    void default_options(YOLOv8Options* options) {
+        options->score_threshold = 0.25f;
+        options->nms_threshold = 0.45f;
+        options->input_size = reference_size;
+        options->max_detections = 0;
+        options->classes = nullptr;
+        options->class_count = 0;
+        options->latency_budget_ms = 0.0;
+    }
+
+    // The options process_frame, tiles, batches and videos run with.
+    const YOLOv8Options& request_defaults() {
+        static const YOLOv8Options defaults = [] {
+            YOLOv8Options options;
+            default_options(&options);
+            return options;
+        }();
+        return defaults;
+    }
+
+    // YOLOv8's strides need inputs in multiples of 32.
+    int round_input_size(int size) {
+        return std::max(32, (size + 16) / 32 * 32);
+    }
+
+    int model_input_size(const YOLOv8Options& options) {
+        if (options.input_size <= 0) return reference_size;
+        return round_input_size(options.input_size);
+    }
+
+    // Result cache key component for the options that change the detections: 0 for the defaults, so process_frame
+    // keeps its existing cache entries. The latency budget is left out; a request it sends to a smaller input size
+    // is keyed by that size instead.
+    uint64_t options_identity(const YOLOv8Options& options) {
+        const YOLOv8Options& defaults = request_defaults();
+        bool all_classes = !options.classes || options.class_count <= 0;
+        if (options.score_threshold == defaults.score_threshold && options.nms_threshold == defaults.nms_threshold &&
+            model_input_size(options) == reference_size && options.max_detections <= 0 && all_classes) {
+            return 0;
+        }
+
+        std::string identity = std::to_string(options.score_threshold) + "|" + std::to_string(options.nms_threshold) + "|" +
+                               std::to_string(model_input_size(options)) + "|" + std::to_string(std::max(0, options.max_detections));
+        if (!all_classes) {
+            std::vector<int> classes(options.classes, options.classes + options.class_count);
+            std::sort(classes.begin(), classes.end());
+            classes.erase(std::unique(classes.begin(), classes.end()), classes.end());
+            for (int class_id : classes) identity += "|" + std::to_string(class_id);
+        }
+        return hash64(identity.data(), identity.size());
     }
 
-    // Finds the maximum score class (the class_id that will be used going forward).
-    std::tuple<float, int> find_max_score(const std::vector<float>& scores) {
-        float maxScore = scores[0];
-        int maxIndex = 0;
-        for (int i = 1; i < scores.size(); ++i) {
-            if (scores[i] > maxScore) {
-                maxScore = scores[i];
-                maxIndex = i;
+    bool class_allowed(const YOLOv8Options& options, int class_id) {
+        if (!options.classes || options.class_count <= 0) return true;
+        return std::find(options.classes, options.classes + options.class_count, class_id) != options.classes + options.class_count;
+    }
+
+    // ".onnx" files go to ONNX Runtime, ".xml" (OpenVINO IR) to OpenVINO, everything else is treated as TorchScript.
+    int backend_for_path(const std::string& model_path) {
+        std::string extension = model_path.substr(std::min(model_path.size(), model_path.find_last_of('.')));
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension == ".onnx") return YOLO_BACKEND_ONNXRUNTIME;
+        if (extension == ".xml") return YOLO_BACKEND_OPENVINO;
+        return YOLO_BACKEND_TORCH;
+    }
+
+    std::unique_ptr<InferenceBackend> load_torch_backend(const char* model_path, const YOLOv8LoadOptions* options, int& precision, std::vector<int>& class_map) {
+        auto backend = std::make_unique<TorchBackend>();
+        torch::jit::ExtraFilesMap extra_files{{"config.txt", ""}};
+        backend->module = torch::jit::load(model_path, c10::nullopt, extra_files);
+        class_map = parse_class_list(read_config_list(extra_files["config.txt"], "classes"));
+        std::string qengine = read_config_value(extra_files["config.txt"], "qengine");
+        if (!select_quantized_engine(qengine)) return nullptr;
+
+        // BF16 only pays off with native bf16 instructions; elsewhere it would be emulated and slower than FP32.
+        // Quantized models already run their convs in INT8 so they stay as exported.
+        if (options->precision == YOLO_PRECISION_BF16) {
+            if (!qengine.empty()) {
+                std::cout << "BF16 requested for a quantized model, keeping INT8." << std::endl;
+            } else if (!cpu_supports_bf16()) {
+                std::cout << "BF16 requested but the CPU has no AVX512-BF16/AMX-BF16, using FP32." << std::endl;
+            } else {
+                backend->module.to(torch::kBFloat16);
+                backend->input_dtype = torch::kBFloat16;
+                precision = YOLO_PRECISION_BF16;
+                std::cout << "Model weights converted to BF16." << std::endl;
             }
         }
-        return std::make_tuple(maxScore, maxIndex);
+        return backend;
     }
 
-    // IoU used for NMS
-    float iou(const std::array<float, 4>& box1, const std::array<float, 4>& box2) {
-         // Convert (x, y, w, h) to (x1, y1, x2, y2)
-        float x1_1 = box1[0];
-        float y1_1 = box1[1];
-        float x2_1 = box1[0] + box1[2];
-        float y2_1 = box1[1] + box1[3];
+    std::unique_ptr<InferenceBackend> load_onnxruntime_backend(const char* model_path, const YOLOv8LoadOptions* options, std::vector<int>& class_map) {
+#ifdef YOLO_WITH_ONNXRUNTIME
+        if (options->precision != YOLO_PRECISION_FP32) {
+            std::cout << "ONNX Runtime backend runs the model as exported, ignoring the precision option." << std::endl;
+        }
+
+        Ort::SessionOptions session_options;
+        session_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+        session_options.DisablePerSessionThreads();
+
+        auto backend = std::make_unique<OnnxRuntimeBackend>();
+        backend->session = std::make_unique<Ort::Session>(onnxruntime_env(), model_path, session_options);
 
-        float x1_2 = box2[0];
-        float y1_2 = box2[1];
-        float x2_2 = box2[0] + box2[2];
-        float y2_2 = box2[1] + box2[3];
+        Ort::AllocatorWithDefaultOptions allocator;
+        backend->input_name = backend->session->GetInputNameAllocated(0, allocator).get();
+        backend->output_name = backend->session->GetOutputNameAllocated(0, allocator).get();
+        if (auto classes = backend->session->GetModelMetadata().LookupCustomMetadataMapAllocated("classes", allocator)) {
+            class_map = parse_class_list(classes.get());
+        }
+        return backend;
+#else
+        (void)model_path;
+        (void)options;
+        (void)class_map;
+        std::cerr << "ONNX model requested but libYOLO was built without ONNX Runtime (YOLO_WITH_ONNXRUNTIME)." << std::endl;
+        return nullptr;
+#endif
+    }
 
-        // Coordinates of the intersectional box
-        float inter_x1 = std::max(x1_1, x1_2);
-        float inter_y1 = std::max(y1_1, y1_2);
-        float inter_x2 = std::min(x2_1, x2_2);
-        float inter_y2 = std::min(y2_1, y2_2);
+    std::unique_ptr<InferenceBackend> load_openvino_backend(const char* model_path, const YOLOv8LoadOptions* options, std::vector<int>& class_map) {
+#ifdef YOLO_WITH_OPENVINO
+        if (options->precision != YOLO_PRECISION_FP32) {
+            std::cout << "OpenVINO backend picks its own inference precision, ignoring the precision option." << std::endl;
+        }
 
-        float inter_area = std::max(0.0f, inter_x2 - inter_x1) * std::max(0.0f, inter_y2 - inter_y1);
-        float box1_area = (x2_1 - x1_1) * (y2_1 - y1_1);
-        float box2_area = (x2_2 - x1_2) * (y2_2 - y1_2);
+        // A single caller wants the lowest latency per frame; several concurrent callers on one handle map to
+        // THROUGHPUT mode with one stream (and infer request) per expected concurrent call.
+        int concurrency = std::max(1, options->concurrency);
+        auto backend = std::make_unique<OpenVinoBackend>();
+        std::shared_ptr<ov::Model> network = openvino_core().read_model(model_path);
+        if (network->has_rt_info("model_info", "classes")) {
+            class_map = parse_class_list(network->get_rt_info<std::string>("model_info", "classes"));
+        }
+        if (concurrency == 1) {
+            backend->compiled_model = openvino_core().compile_model(network, "CPU",
+                ov::hint::performance_mode(ov::hint::PerformanceMode::LATENCY));
+        } else {
+            backend->compiled_model = openvino_core().compile_model(network, "CPU",
+                ov::hint::performance_mode(ov::hint::PerformanceMode::THROUGHPUT),
+                ov::hint::num_requests(static_cast<uint32_t>(concurrency)));
+        }
 
-    return inter_area / (box1_area + box2_area - inter_area);
-}
+        for (int i = 0; i < concurrency; ++i) {
+            backend->requests.push_back(backend->compiled_model.create_infer_request());
+            backend->free_requests.push_back(i);
+        }
+        std::cout << "OpenVINO model compiled with " << backend->compiled_model.get_property(ov::num_streams).num
+                  << " stream(s), " << concurrency << " infer request(s)." << std::endl;
+        return backend;
+#else
+        (void)model_path;
+        (void)options;
+        (void)class_map;
+        std::cerr << "OpenVINO model requested but libYOLO was built without OpenVINO (YOLO_WITH_OPENVINO)." << std::endl;
+        return nullptr;
+#endif
+    }
 
-    // NMS function to filter model outputs.
-    std::vector<int> apply_nms(
-        const std::vector<std::array<float, 4>>& boxes,
-        const std::vector<float>& scores,
-        const std::vector<int>& class_ids,
-        float score_threshold, float nms_threshold
-    ) {
-        std::vector<int> indices(boxes.size());
-        std::iota(indices.begin(), indices.end(), 0);
+    // Load model from torchscript file
+    YOLOv8* load_model(const char* model_path) {
+        YOLOv8LoadOptions options;
+        default_load_options(&options);
+        return load_model_with_options(model_path, &options);
+    }
 
-        std::sort(indices.begin(), indices.end(), [&scores](int i1, int i2) {
-            return scores[i1] > scores[i2];
-        });
+    // Load model with the backend chosen by options->backend (or by file extension when YOLO_BACKEND_AUTO).
+    // Identifies the loaded weights for the result cache: the path, its size and modification time, and the settings
+    // that change the outputs. Handles loading the same file share cache entries; replacing the file does not.
+    uint64_t model_identity(const char* model_path, int backend, int precision) {
+        struct stat info {};
+        stat(model_path, &info);
+        std::string identity = std::string(model_path) + "|" + std::to_string(info.st_size) + "|" + std::to_string(info.st_mtime) +
+                               "|" + std::to_string(backend) + "|" + std::to_string(precision);
+        return hash64(identity.data(), identity.size());
+    }
 
-        std::vector<int> keep;
-        std::vector<bool> suppressed(boxes.size(), false);
-
-        for (int i = 0; i < indices.size(); ++i) {
-            int idx = indices[i];
-            if (suppressed[idx] || scores[idx] < score_threshold) continue;
-            keep.push_back(idx);
-            for (int j = i + 1; j < indices.size(); ++j) {
-                int next_idx = indices[j];
-                if (iou(boxes[idx], boxes[next_idx]) > nms_threshold) {
-                    suppressed[next_idx] = true;
-                }
+    // Resident size of the weights: the TorchScript module's parameters and buffers, otherwise the model files (ONNX
+    // Runtime and OpenVINO keep roughly the file's weights in memory).
+    size_t model_weight_bytes(const InferenceBackend* backend, int backend_type, const std::string& model_path) {
+        size_t bytes = 0;
+        if (backend_type == YOLO_BACKEND_TORCH) {
+            const auto& module = static_cast<const TorchBackend*>(backend)->module;
+            for (const auto& parameter : module.parameters()) bytes += parameter.nbytes();
+            for (const auto& buffer : module.buffers()) bytes += buffer.nbytes();
+            return bytes;
+        }
+
+        struct stat info {};
+        if (stat(model_path.c_str(), &info) == 0) bytes += info.st_size;
+        if (backend_type == YOLO_BACKEND_OPENVINO) {
+            std::string weights_path = model_path.substr(0, model_path.find_last_of('.')) + ".bin";
+            if (stat(weights_path.c_str(), &info) == 0) bytes += info.st_size;
+        }
+        return bytes;
+    }
+
+    YOLOv8* load_model_with_options(const char* model_path, const YOLOv8LoadOptions* options) {
+        auto load_start = std::chrono::steady_clock::now();
+        YOLOv8* model = new YOLOv8();
+        int backend = options->backend == YOLO_BACKEND_AUTO ? backend_for_path(model_path) : options->backend;
+        try {
+            // Runtime threads started while loading (ONNX Runtime's pools, OpenVINO's stream executors) inherit the
+            // inference CPUs from this thread.
+            ScopedAffinity inference_affinity(inference_cpus());
+            if (backend == YOLO_BACKEND_ONNXRUNTIME) {
+                model->backend = load_onnxruntime_backend(model_path, options, model->class_map);
+            } else if (backend == YOLO_BACKEND_OPENVINO) {
+                model->backend = load_openvino_backend(model_path, options, model->class_map);
+            } else {
+                model->backend = load_torch_backend(model_path, options, model->precision, model->class_map);
             }
+        } catch (const std::exception& e) {
+            std::cerr << "Error loading the model: " << e.what() << std::endl;
+            delete model;
+            return nullptr;
+        }
+
+        if (!model->backend) {
+            delete model;
+            return nullptr;
+        }
+
+        model->model_id = model_identity(model_path, backend, model->precision);
+        model->weight_bytes = model_weight_bytes(model->backend.get(), backend, model_path);
+        if (!model->class_map.empty()) {
+            std::cout << "Class-pruned model with " << model->class_map.size() << " classes." << std::endl;
         }
 
-        return keep;
+        // Rasterise the label font once so drawing labels per frame is only row copies.
+        build_label_renderer(model->labels);
+        model->load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count();
+        return model;
     }
 
-    std::vector<unsigned char> draw_rectangles(std::vector<unsigned char>& image_data, int width, int height, const std::vector<std::tuple<std::array<float, 4>, float, int>>& nms_boxes) {
+    // Draws box outlines into rows [band_top, band_top + band_rows) of a width x height image, where band points at
+    // row band_top. The whole image is one band; the streaming writer draws one band of rows at a time.
+    void draw_rectangles_band(unsigned char* band, int width, int height, int band_top, int band_rows, const std::vector<std::tuple<std::array<float, 4>, float, int>>& nms_boxes) {
         // Calculate scale factors
-        float scale_x = static_cast<float>(width) / 640.0;
-        float scale_y = static_cast<float>(height) / 640.0;
+        float scale_x = static_cast<float>(width) / reference_size;
+        float scale_y = static_cast<float>(height) / reference_size;
         int outline_width = 5;
+        int band_bottom = band_top + band_rows;
+
+        auto fill = [&](int y, int x_begin, int x_end) {
+            unsigned char* row = band + static_cast<size_t>(y - band_top) * width * 3;
+            for (int x = std::max(0, x_begin); x < x_end && x < width; ++x) {
+                row[x * 3] = 0;         // Red channel
+                row[x * 3 + 1] = 255;   // Green channel
+                row[x * 3 + 2] = 0;     // Blue channel
+            }
+        };
+
+        for (const auto& box_info : nms_boxes) {
+            auto box = std::get<0>(box_info);
+
+            // Scale the bounding box coordinates
+            int left = static_cast<int>(box[0] * scale_x);
+            int top = static_cast<int>(box[1] * scale_y);
+            int right = static_cast<int>((box[0] + box[2]) * scale_x);
+            int bottom = static_cast<int>((box[1] + box[3]) * scale_y);
 
+            // Ensure coordinates are valid
+            if (left < 0 || top < 0 || right >= width || bottom >= height) continue;
+
+            // Top and bottom borders span the box; rows in between only get the left and right borders
+            for (int y = std::max(top, band_top); y < bottom && y < band_bottom; ++y) {
+                if (y < top + outline_width || y >= bottom - outline_width) {
+                    fill(y, left, right);
+                } else {
+                    fill(y, left, left + outline_width);
+                    fill(y, right - outline_width, right);
+                }
+            }
+        }
+    }
 
+    void draw_rectangles(unsigned char* image_data, int width, int height, const std::vector<std::tuple<std::array<float, 4>, float, int>>& nms_boxes) {
         for (size_t i = 0; i < nms_boxes.size(); ++i) {
             const auto& box_info = nms_boxes[i];
             const auto& box = std::get<0>(box_info);
             float score = std::get<1>(box_info);
             int class_id = std::get<2>(box_info);
-            
+
             // For debug can be removed.
             std::cout << "Box " << i << ": ["
                     << "x=" << box[0] << ", "
@@ -116,163 +696,1559 @@ extern "C" {
                     << "w=" << box[2] << ", "
                     << "h=" << box[3] << "], "
                     << "score=" << score << ", "
-                    << "class_id=" << class_id << std::endl;
+                    << "class_id=" << class_id
+                    << " (" << (class_id >= 0 && class_id < 80 ? COCO_CLASSES[class_id] : "unknown") << ")" << std::endl;
+
+            int left = static_cast<int>(box[0] * width / reference_size);
+            int top = static_cast<int>(box[1] * height / reference_size);
+            int right = static_cast<int>((box[0] + box[2]) * width / reference_size);
+            int bottom = static_cast<int>((box[1] + box[3]) * height / reference_size);
+            if (left < 0 || top < 0 || right >= width || bottom >= height) {
+                std::cerr << "Box coordinates are out of bounds, skipping drawing this box." << std::endl;
+            }
         }
 
+        draw_rectangles_band(image_data, width, height, 0, height, nms_boxes);
+    }
+
+    // Maps detections from model input coordinates (reference_size square) to width x height frame pixels.
+    void to_frame_detections(const std::vector<std::tuple<std::array<float, 4>, float, int>>& nms_boxes, int width, int height, std::vector<YOLOv8Detection>& detections) {
+        float scale_x = static_cast<float>(width) / reference_size;
+        float scale_y = static_cast<float>(height) / reference_size;
+        detections.clear();
         for (const auto& box_info : nms_boxes) {
-            auto box = std::get<0>(box_info);
-            
-            // Scale the bounding box coordinates
-            int left = static_cast<int>(box[0] * scale_x);
-            int top = static_cast<int>(box[1] * scale_y);
-            int right = static_cast<int>((box[0] + box[2]) * scale_x);
-            int bottom = static_cast<int>((box[1] + box[3]) * scale_y);
+            const auto& box = std::get<0>(box_info);
+            detections.push_back({box[0] * scale_x, box[1] * scale_y, box[2] * scale_x, box[3] * scale_y, std::get<1>(box_info), std::get<2>(box_info), -1});
+        }
+    }
 
-            std::cout << "Valid box: [" << left << ", " << top << ", " << right << ", " << bottom << "]" << std::endl;
+    // The first forward includes lazy initialisation (kernel selection, graph optimisation, memory pools) so it is
+    // kept apart from the steady-state mean.
+    void record_forward_time(YOLOv8* model, double forward_ms) {
+        std::lock_guard<std::mutex> lock(model->stats_mutex);
+        if (model->frames == 0) model->first_forward_ms = forward_ms;
+        else model->total_forward_ms += forward_ms;
+        ++model->frames;
+    }
 
-            // Ensure coordinates are valid
-            if (left < 0 || top < 0 || right >= width || bottom >= height) {
-                std::cerr << "Box coordinates are out of bounds, skipping drawing this box." << std::endl;
-                continue;
-            }
+    double milliseconds_since(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
 
-            // Draw top and bottom borders
-            for (int y = top; y < top + outline_width && y < height; ++y) {
-                for (int x = left; x < right && x < width; ++x) {
-                    int index = y * width * 3 + x * 3;
-                    image_data[index] = 0;         // Red channel
-                    image_data[index + 1] = 255;   // Green channel
-                    image_data[index + 2] = 0;     // Blue channel
-                }
-            }
+    // Weight of the newest frame in the per-size moving averages, enough to follow a change in machine load within a
+    // few frames without one slow frame swinging the choice.
+    const double latency_smoothing = 0.2;
 
-            for (int y = bottom - outline_width; y < bottom && y < height; ++y) {
-                for (int x = left; x < right && x < width; ++x) {
-                    int index = y * width * 3 + x * 3;
-                    image_data[index] = 0;         // Red channel
-                    image_data[index + 1] = 255;   // Green channel
-                    image_data[index + 2] = 0;     // Blue channel
-                }
+    // As with first_forward_ms, the first frame at a size pays for lazy initialisation and is left out.
+    void record_size_latency(YOLOv8* model, int size, double ms) {
+        std::lock_guard<std::mutex> lock(model->stats_mutex);
+        SizeLatency& latency = model->size_latency[size];
+        if (latency.frames == 1) latency.ms = ms;
+        else if (latency.frames > 1) latency.ms += latency_smoothing * (ms - latency.ms);
+        ++latency.frames;
+    }
+
+    void reject_input_size(YOLOv8* model, int size) {
+        std::lock_guard<std::mutex> lock(model->stats_mutex);
+        model->size_latency[size].rejected = true;
+    }
+
+    // Expected time at size: its moving average, else the nearest measured size's scaled by the pixel count, else 0
+    // (nothing measured yet, so the size is tried). Called with stats_mutex held.
+    double expected_latency(const YOLOv8* model, int size) {
+        const SizeLatency* nearest = nullptr;
+        int nearest_size = 0;
+        for (const auto& entry : model->size_latency) {
+            if (entry.second.frames < 2) continue;
+            if (entry.first == size) return entry.second.ms;
+            if (!nearest || std::abs(entry.first - size) < std::abs(nearest_size - size)) {
+                nearest = &entry.second;
+                nearest_size = entry.first;
             }
+        }
+        if (!nearest) return 0.0;
+        double ratio = static_cast<double>(size) / nearest_size;
+        return nearest->ms * ratio * ratio;
+    }
 
-            // Draw left and right borders
-            for (int y = top; y < bottom && y < height; ++y) {
-                for (int x = left; x < left + outline_width && x < width; ++x) {
-                    int index = y * width * 3 + x * 3;
-                    image_data[index] = 0;         // Red channel
-                    image_data[index + 1] = 255;   // Green channel
-                    image_data[index + 2] = 0;     // Blue channel
-                }
+    // Input size for a request: the requested size, or with a latency budget the largest of the requested size, 3/4
+    // and 1/2 of it expected to finish in what is left of the budget after spent_ms, and the smallest when none is.
+    // Sizes the backend rejected are skipped.
+    int choose_input_size(YOLOv8* model, const YOLOv8Options& options, double spent_ms) {
+        int requested = model_input_size(options);
+        if (options.latency_budget_ms <= 0.0) return requested;
+
+        double remaining_ms = options.latency_budget_ms - spent_ms;
+        const int candidates[] = {requested, round_input_size(requested * 3 / 4), round_input_size(requested / 2)};
+        int chosen = requested;
+
+        std::lock_guard<std::mutex> lock(model->stats_mutex);
+        for (int size : candidates) {
+            auto latency = model->size_latency.find(size);
+            if (size != requested && latency != model->size_latency.end() && latency->second.rejected) continue;
+            chosen = size;
+            if (expected_latency(model, size) <= remaining_ms) break;
+        }
+        return chosen;
+    }
+
+    void get_model_stats(YOLOv8* model, YOLOv8Stats* stats) {
+        std::lock_guard<std::mutex> lock(model->stats_mutex);
+        stats->load_ms = model->load_ms;
+        stats->first_forward_ms = model->first_forward_ms;
+        stats->mean_forward_ms = model->frames > 1 ? model->total_forward_ms / (model->frames - 1) : 0.0;
+        stats->frames = model->frames;
+        stats->skipped_frames = model->skipped_frames;
+        stats->frame_allocations = model->frame_allocations;
+        stats->weight_bytes = model->weight_bytes;
+
+        std::lock_guard<std::mutex> workspace_lock(model->workspace_mutex);
+        stats->workspace_bytes = 0;
+        for (const auto& workspace : model->free_workspaces) stats->workspace_bytes += workspace->bytes();
+    }
+
+    void set_motion_gate(YOLOv8* model, float threshold) {
+        std::lock_guard<std::mutex> lock(model->motion_mutex);
+        model->motion_gate.set_threshold(threshold);
+        model->motion_gate.reset();
+        model->has_last_boxes = false;
+    }
+
+    // Decodes image `index` of a backend output into NMS-filtered (box, score, class_id) detections in model input
+    // pixels, using (and growing) the scratch buffers. Models exported with --nms already return [K, 6]
+    // (x, y, w, h, score, class_id) detections after NMS, which are only filtered by score and class. Class-pruned
+    // models have their output channels mapped back to COCO class ids.
+    void decode_output(const YOLOv8* model, const at::Tensor& output, int64_t index, const YOLOv8Options& options, DecodeScratch& scratch, std::vector<std::tuple<std::array<float, 4>, float, int>>& nms_boxes) {
+        const std::vector<int>& class_map = model->class_map;
+        auto to_class_id = [&class_map](int channel) {
+            return channel >= 0 && static_cast<size_t>(channel) < class_map.size() ? class_map[channel] : channel;
+        };
 
-                for (int x = right - outline_width; x < right && x < width; ++x) {
-                    int index = y * width * 3 + x * 3;
-                    image_data[index] = 0;         // Red channel
-                    image_data[index + 1] = 255;   // Green channel
-                    image_data[index + 2] = 0;     // Blue channel
+        scratch.boxes.clear();
+        scratch.scores.clear();
+        scratch.class_ids.clear();
+
+        // Read through the data pointer: indexing or reshaping the tensor would allocate a view for every frame.
+        at::Tensor contiguous_output = output.contiguous();
+        const float* data = contiguous_output.data_ptr<float>();
+        bool decoded_in_graph = output.dim() == 2 && output.size(1) == 6;
+        if (decoded_in_graph) {
+            for (int64_t i = 0; i < output.size(0); ++i, data += 6) {
+                int class_id = to_class_id(static_cast<int>(data[5]));
+                if (data[4] < options.score_threshold || !class_allowed(options, class_id)) continue;
+                scratch.boxes.push_back({data[0], data[1], data[2], data[3]});
+                scratch.scores.push_back(data[4]);
+                scratch.class_ids.push_back(class_id);
+            }
+            scratch.keep.resize(scratch.boxes.size());
+            std::iota(scratch.keep.begin(), scratch.keep.end(), 0);
+        } else {
+            // Filter anchors with a lower score than the threshold, storing the highest score class_id, straight from
+            // the [84, 8400] output (no transpose copy).
+            int channels = static_cast<int>(output.size(1));
+            int anchors = static_cast<int>(output.size(2));
+            const float* predictions = data + index * channels * anchors;
+            float* best_scores = scratch.best_scores.reserve(anchors);
+            int* best_classes = scratch.best_classes.reserve(anchors);
+            if (options.classes && options.class_count > 0 && !class_map.empty()) {
+                // The allow-list holds COCO ids; a pruned model's channels are positions in its class_map.
+                scratch.allowed_channels.clear();
+                for (size_t channel = 0; channel < class_map.size(); ++channel) {
+                    if (class_allowed(options, class_map[channel])) scratch.allowed_channels.push_back(static_cast<int>(channel));
                 }
+                find_best_allowed_classes(predictions, channels, anchors, 0, anchors, scratch.allowed_channels.data(),
+                                          static_cast<int>(scratch.allowed_channels.size()), best_scores, best_classes);
+            } else if (options.classes && options.class_count > 0) {
+                find_best_allowed_classes(predictions, channels, anchors, 0, anchors, options.classes, options.class_count, best_scores, best_classes);
+            } else {
+                find_best_classes(predictions, channels, anchors, 0, anchors, best_scores, best_classes);
+            }
+            collect_candidates(predictions, anchors, 0, anchors, best_scores, best_classes, options.score_threshold, scratch.boxes, scratch.scores, scratch.class_ids);
+            if (!class_map.empty()) {
+                for (int& class_id : scratch.class_ids) class_id = to_class_id(class_id);
             }
+            apply_nms(scratch.boxes, scratch.scores, scratch.class_ids, options.score_threshold, options.nms_threshold, model->max_candidates, scratch.order, scratch.suppressed, scratch.keep);
+        }
+        // Both paths keep detections best first.
+        if (options.max_detections > 0 && scratch.keep.size() > static_cast<size_t>(options.max_detections)) {
+            scratch.keep.resize(options.max_detections);
         }
 
-        return image_data;
+        nms_boxes.clear();
+        for (auto idx : scratch.keep) {
+            nms_boxes.emplace_back(scratch.boxes[idx], scratch.scores[idx], scratch.class_ids[idx]);
+        }
     }
 
-    void process_frame(YOLOv8* model, const char* frame_path, const char* output_path) {
-        int width, height, channels;
-        unsigned char* original_data = stbi_load(frame_path, &width, &height, &channels, 3);
-        if (!original_data) {
-            std::cerr << "Failed to read the image\n";
-            return;
+    // Interleaved RGB bytes to planar float RGB in [0, 1], the layout and range the model takes.
+    void to_planar(const unsigned char* rgb, size_t pixels, float* out) {
+        float* r = out;
+        float* g = r + pixels;
+        float* b = g + pixels;
+        for (size_t p = 0; p < pixels; ++p, rgb += 3) {
+            r[p] = rgb[0] / 255.0f;
+            g[p] = rgb[1] / 255.0f;
+            b[p] = rgb[2] / 255.0f;
         }
+    }
 
-        std::cout << "Image loaded: " << width << "x" << height << " Channels: " << channels << std::endl;
+    // Resizes an RGB image into the workspace's model input, with stb_image_resize's work memory taken from the
+    // workspace arena instead of the heap.
+    unsigned char* resize_to_input(FrameWorkspace& workspace, const unsigned char* image_data, int width, int height, int size) {
+        unsigned char* resized = workspace.resized.reserve(static_cast<size_t>(size) * size * 3);
+        workspace.resize_arena.reset();
+        if (!stbir_resize_uint8_generic(image_data, width, height, 0, resized, size, size, 0, 3, STBIR_ALPHA_CHANNEL_NONE, 0,
+                                        STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT, STBIR_COLORSPACE_LINEAR, &workspace.resize_arena)) {
+            return nullptr;
+        }
+        return resized;
+    }
 
-        int new_width = 640;
-        int new_height = 640;
-        std::vector<unsigned char> resized_data(new_width * new_height * 3);
+    void set_pixel_budget(YOLOv8* model, unsigned long long max_pixels, int policy) {
+        model->max_pixels = max_pixels;
+        model->oversize_policy = policy;
+    }
 
-        if (!stbir_resize_uint8(original_data, width, height, 0, resized_data.data(), new_width, new_height, 0, 3)) {
-            std::cerr << "Failed to resize the image\n";
-            stbi_image_free(original_data);
-            return;
-        }
+    void set_max_candidates(YOLOv8* model, int max_candidates) {
+        model->max_candidates = std::max(0, max_candidates);
+    }
 
-        std::cout << "Image resized." << std::endl;
+    bool exceeds_pixel_budget(unsigned long long max_pixels, int width, int height) {
+        return max_pixels && static_cast<unsigned long long>(width) * height > max_pixels;
+    }
+
+    // Runs the backend on a square RGB image of the options' input size and decodes its detections (in reference_size
+    // model input coordinates). The input tensor and every decode buffer come from the workspace. skipped, when given,
+    // is set when the motion gate answered with the previous detections instead.
+    bool detect(YOLOv8* model, FrameWorkspace& workspace, const unsigned char* resized_data, const YOLOv8Options& options, uint64_t options_id, std::vector<std::tuple<std::array<float, 4>, float, int>>& nms_boxes, bool* skipped = nullptr) {
+        int new_width = model_input_size(options);
+        int new_height = new_width;
+        if (skipped) *skipped = false;
 
-        // Load LibTorch tensor from resized image data
+        if (model->motion_gate.threshold() > 0.0f) {
+            std::lock_guard<std::mutex> lock(model->motion_mutex);
+            if (model->motion_gate.is_static(resized_data, new_width) && model->has_last_boxes && model->last_options == options_id) {
+                nms_boxes = model->last_boxes;
+                std::lock_guard<std::mutex> stats_lock(model->stats_mutex);
+                ++model->skipped_frames;
+                std::cout << "No motion, reusing the previous detections." << std::endl;
+                if (skipped) *skipped = true;
+                return true;
+            }
+        }
 
-        auto input_tensor = torch::from_blob(resized_data.data(), {1, new_height, new_width, 3}, torch::kUInt8);
-        input_tensor = input_tensor.permute({0, 3, 1, 2}).to(torch::kFloat);
-        input_tensor = input_tensor.div(255);
+        // Fill the workspace's input tensor in place rather than building a new one from the image each frame
+        if (!workspace.input.defined() || workspace.input.size(2) != new_height) {
+            workspace.input = torch::empty({1, 3, new_height, new_width}, torch::kFloat);
+        }
+        to_planar(resized_data, static_cast<size_t>(new_width) * new_height, workspace.input.data_ptr<float>());
 
         std::cout << "Tensor prepared." << std::endl;
 
-        std::vector<torch::jit::IValue> inputs;
-        inputs.push_back(input_tensor);
-
         at::Tensor output;
         try {
-            output = model->module.forward(inputs).toTensor();
-        } catch (const c10::Error& e) {
+            auto forward_start = std::chrono::steady_clock::now();
+            unsigned long long forward_allocations_before = thread_allocation_count();
+            output = model->backend->forward(workspace.input);
+            workspace.forward_allocations = thread_allocation_count() - forward_allocations_before;
+            record_forward_time(model, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - forward_start).count());
+        } catch (const std::exception& e) {
             std::cerr << "Error during model inference: " << e.what() << std::endl;
-            stbi_image_free(original_data);
-            return;
+            return false;
         }
 
         std::cout << "Model inference done." << std::endl;
 
-        // Initialise vectors for boxes, scores and class_ids
-
-        std::vector<std::array<float, 4>> boxes;
-        std::vector<float> scores;
-        std::vector<int> class_ids;
+        decode_output(model, output, 0, options, workspace.decode, nms_boxes);
+        if (new_width != reference_size) {
+            float to_reference = static_cast<float>(reference_size) / new_width;
+            for (auto& box_info : nms_boxes) {
+                for (float& value : std::get<0>(box_info)) value *= to_reference;
+            }
+        }
 
-        // Transpose output as per steps in outputs.ipynb
+        if (model->motion_gate.threshold() > 0.0f) {
+            std::lock_guard<std::mutex> lock(model->motion_mutex);
+            model->last_boxes = nms_boxes;
+            model->last_options = options_id;
+            model->has_last_boxes = true;
+        }
+        return true;
+    }
 
-        at::Tensor transposed_output = output[0].transpose(1, 0).contiguous();
-        int rows = transposed_output.size(0);
+    // Inputs over the pixel budget are streamed row by row from the file into the model input and into a display copy
+    // scaled down to fit max_pixels, so the full-resolution frame is never allocated. JPEGs are decoded straight to a
+    // reduced size in the DCT domain when that still leaves enough pixels for both. Without an output_path only the
+    // model input is built.
+    bool process_frame_streaming(
+        YOLOv8* model, FrameWorkspace& workspace, const char* frame_path, const char* output_path, int width, int height,
+        unsigned long long max_pixels, const YOLOv8Options& options, std::vector<std::tuple<std::array<float, 4>, float, int>>& nms_boxes
+    ) {
+        int size = model_input_size(options);
+        double scale = std::sqrt(static_cast<double>(max_pixels) / (static_cast<double>(width) * height));
+        int out_width = output_path ? std::max(1, static_cast<int>(width * scale)) : 1;
+        int out_height = output_path ? std::max(1, static_cast<int>(height * scale)) : 1;
 
-        // Iterate over rows of output and filtering boxes with a lower score than 0.25 and storing the highest score class_id
+        auto reader = open_row_reader(frame_path, jpeg_scale_denom(width, height, std::max(size, out_width), std::max(size, out_height)));
+        if (!reader) {
+            std::cerr << "Image exceeds the pixel budget and cannot be streamed (JPEG and non-interlaced PNG only)\n";
+            return false;
+        }
 
-        for (int i = 0; i < rows; ++i) {
-            auto data = transposed_output[i].data_ptr<float>();
-            std::vector<float> class_scores(data + 4, data + transposed_output.size(1));
-            auto [maxScore, maxClassIndex] = find_max_score(class_scores);
-            if (maxScore >= 0.25) {
-                std::array<float, 4> box = {data[0] - (0.5 * data[2]), data[1] - (0.5 * data[3]), data[2], data[3]};
-                boxes.push_back(box);
-                scores.push_back(maxScore);
-                class_ids.push_back(maxClassIndex);
+        StreamingDownscaler model_input(reader->width(), reader->height(), size, size);
+        std::unique_ptr<StreamingDownscaler> display;
+        if (output_path) display = std::make_unique<StreamingDownscaler>(reader->width(), reader->height(), out_width, out_height);
+        std::vector<unsigned char> row(static_cast<size_t>(reader->width()) * 3);
+        for (int y = 0; y < reader->height(); ++y) {
+            if (!reader->read_row(row.data())) {
+                std::cerr << "Failed to read the image\n";
+                return false;
             }
+            model_input.push_row(row.data());
+            if (display) display->push_row(row.data());
         }
+        reader.reset();
 
-        auto keep = apply_nms(boxes, scores, class_ids, 0.25, 0.45);
-
-        std::vector<std::tuple<std::array<float, 4>, float, int>> nms_boxes;
-        for (auto idx : keep) {
-            nms_boxes.emplace_back(boxes[idx], scores[idx], class_ids[idx]);
-        }
+        std::cout << "Image streamed: " << width << "x" << height << " -> " << out_width << "x" << out_height << std::endl;
 
-        // Recall the original data to draw boxes on
-        std::vector<unsigned char> image_data(original_data, original_data + (width * height * 3));
-        stbi_image_free(original_data);
+        if (!detect(model, workspace, model_input.result().data(), options, options_identity(options), nms_boxes)) return false;
+        if (!display) return true;
 
-        try {
-            image_data = draw_rectangles(image_data, width, height, nms_boxes);
-            std::cout << "Drawing rectangles done." << std::endl;
-        } catch (const std::exception& e) {
-            std::cerr << "Error during drawing rectangles: " << e.what() << std::endl;
-            return;
-        }
+        std::vector<unsigned char> image_data = display->release();
+        draw_rectangles(image_data.data(), out_width, out_height, nms_boxes);
+        draw_labels(image_data.data(), out_width, out_height, model->labels, nms_boxes);
 
-        if (!stbi_write_jpg(output_path, width, height, 3, image_data.data(), 100)) {
+        if (!stbi_write_jpg(output_path, out_width, out_height, 3, image_data.data(), 100)) {
             std::cerr << "Failed to save the image\n";
         } else {
             std::cout << "Image saved to " << output_path << std::endl;
         }
+        return true;
     }
 
+    // Shared by every handle; entries are told apart by the model_id in their key.
+    ResultCache& result_cache() {
+        static ResultCache cache;
+        return cache;
+    }
+
+    void set_result_cache(unsigned long long max_bytes, int store_output) {
+        result_cache().configure(static_cast<size_t>(max_bytes), store_output != 0);
+    }
+
+    void get_result_cache_stats(YOLOv8CacheStats* stats) {
+        auto cache_stats = result_cache().stats();
+        stats->hits = cache_stats.hits;
+        stats->misses = cache_stats.misses;
+        stats->entries = cache_stats.entries;
+        stats->bytes = cache_stats.bytes;
+        unsigned long long lookups = cache_stats.hits + cache_stats.misses;
+        stats->hit_ratio = lookups ? static_cast<double>(cache_stats.hits) / lookups : 0.0;
+    }
+
+    NearDuplicateCache& near_duplicate_cache() {
+        static NearDuplicateCache cache;
+        return cache;
+    }
+
+    void set_near_duplicate_cache(unsigned long long max_entries, int max_distance, int max_visits) {
+        near_duplicate_cache().configure(static_cast<size_t>(max_entries), max_distance, max_visits);
+    }
+
+    void get_near_duplicate_cache_stats(YOLOv8CacheStats* stats) {
+        auto cache_stats = near_duplicate_cache().stats();
+        stats->hits = cache_stats.hits;
+        stats->misses = cache_stats.misses;
+        stats->entries = cache_stats.entries;
+        stats->bytes = cache_stats.bytes;
+        unsigned long long lookups = cache_stats.hits + cache_stats.misses;
+        stats->hit_ratio = lookups ? static_cast<double>(cache_stats.hits) / lookups : 0.0;
+    }
+
+    bool read_file(const char* path, std::vector<unsigned char>& bytes) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) return false;
+        bytes.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(bytes.data()), bytes.size()));
+    }
+
+    bool write_file(const char* path, const std::vector<unsigned char>& bytes) {
+        std::ofstream file(path, std::ios::binary);
+        return file && file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    void append_bytes(void* context, void* data, int size) {
+        auto* bytes = static_cast<std::vector<unsigned char>*>(context);
+        bytes->insert(bytes->end(), static_cast<unsigned char*>(data), static_cast<unsigned char*>(data) + size);
+    }
+
+    // Opened by open_persistent_cache. Requests take their own reference, so closing never unmaps a file in use.
+    std::shared_ptr<PersistentCache>& persistent_cache_handle() {
+        static std::shared_ptr<PersistentCache> cache;
+        return cache;
+    }
+
+    std::shared_ptr<PersistentCache> persistent_cache() {
+        return std::atomic_load(&persistent_cache_handle());
+    }
+
+    int open_persistent_cache(const char* path, unsigned long long capacity, int max_detections) {
+        auto cache = std::make_shared<PersistentCache>();
+        if (!cache->open(path, static_cast<size_t>(capacity), max_detections)) return 0;
+        std::atomic_store(&persistent_cache_handle(), std::move(cache));
+        return 1;
+    }
+
+    void close_persistent_cache() {
+        std::atomic_store(&persistent_cache_handle(), std::shared_ptr<PersistentCache>());
+    }
+
+    void get_persistent_cache_stats(YOLOv8CacheStats* stats) {
+        PersistentCache::Stats cache_stats;
+        if (auto cache = persistent_cache()) cache_stats = cache->stats();
+        stats->hits = cache_stats.hits;
+        stats->misses = cache_stats.misses;
+        stats->entries = cache_stats.entries;
+        stats->bytes = cache_stats.bytes;
+        unsigned long long lookups = cache_stats.hits + cache_stats.misses;
+        stats->hit_ratio = lookups ? static_cast<double>(cache_stats.hits) / lookups : 0.0;
+    }
+
+    // One request's trip through the in-memory and persistent result caches.
+    struct CacheLookup {
+        std::vector<unsigned char> encoded;     // The input file, empty when no cache is enabled
+        ResultCacheKey key;
+        CachedResult cached;
+        bool hit = false;                       // cached.detections are valid
+        bool from_memory = false;               // ... and came from the in-memory cache
+    };
+
+    // Writes the annotated image and stores its detections in whichever caches did not supply them (along with the
+    // encoded JPEG when the in-memory cache keeps outputs) for later requests with the same input. Without an
+    // output_path only the detections are stored.
+    void save_output(const char* output_path, const unsigned char* image_data, int width, int height, const std::vector<std::tuple<std::array<float, 4>, float, int>>& nms_boxes, const CacheLookup* lookup) {
+        bool cached = lookup && !lookup->encoded.empty();
+        bool store_output = output_path && result_cache().stores_output();
+        // A memory hit without a stored output is re-inserted when the cache has since started keeping outputs.
+        bool insert_memory = cached && result_cache().enabled() && (!lookup->from_memory || store_output);
+        std::shared_ptr<PersistentCache> persistent = cached && !lookup->hit ? persistent_cache() : nullptr;
+
+        CachedResult result;
+        if (output_path) {
+            bool saved;
+            if (insert_memory && store_output) {
+                saved = stbi_write_jpg_to_func(append_bytes, &result.output, width, height, 3, image_data, 100) && write_file(output_path, result.output);
+            } else {
+                saved = stbi_write_jpg(output_path, width, height, 3, image_data, 100);
+            }
+            if (!saved) {
+                std::cerr << "Failed to save the image\n";
+                return;
+            }
+            std::cout << "Image saved to " << output_path << std::endl;
+        }
+
+        if (persistent) persistent->insert(lookup->key, nms_boxes);
+        if (insert_memory) {
+            result.detections = nms_boxes;
+            result_cache().insert(lookup->key, std::move(result));
+        }
+    }
+
+    // Looks the encoded file up in the in-memory cache, then the persistent one. Returns true when the request is fully
+    // answered (the cached annotated image was written); otherwise lookup holds the file and any cached detections.
+    bool answer_from_cache(YOLOv8* model, const char* frame_path, const char* output_path, uint64_t options_id, CacheLookup& lookup) {
+        auto persistent = persistent_cache();
+        if ((!result_cache().enabled() && !persistent) || !read_file(frame_path, lookup.encoded)) return false;
+
+        lookup.key.content = hash64(lookup.encoded.data(), lookup.encoded.size());
+        lookup.key.model = model->model_id;
+        lookup.key.options = options_id;
+        if (result_cache().enabled() && result_cache().lookup(lookup.key, lookup.cached)) {
+            lookup.hit = lookup.from_memory = true;
+        } else if (persistent) {
+            lookup.hit = persistent->lookup(lookup.key, lookup.cached.detections);
+        }
+        if (!lookup.hit || lookup.cached.output.empty() || !output_path) return false;
+
+        if (!write_file(output_path, lookup.cached.output)) {
+            std::cerr << "Failed to save the image\n";
+        } else {
+            std::cout << "Image saved to " << output_path << " (cached)" << std::endl;
+        }
+        return true;
+    }
+
+    // Fills in result, when given, with up to its capacity of detections in image pixels, and returns how many there were.
+    int report_detections(
+        FrameWorkspace& workspace, const std::vector<std::tuple<std::array<float, 4>, float, int>>& nms_boxes, int width,
+        int height, int input_size, std::chrono::steady_clock::time_point call_start, YOLOv8Result* result
+    ) {
+        int count = static_cast<int>(nms_boxes.size());
+        if (!result) return count;
+        if (result->detections && result->capacity > 0) {
+            std::vector<YOLOv8Detection>& frame_detections = workspace.frame_detections;
+            to_frame_detections(nms_boxes, width, height, frame_detections);
+            std::copy_n(frame_detections.begin(), std::min<size_t>(result->capacity, frame_detections.size()), result->detections);
+        }
+        result->count = count;
+        result->input_size = input_size;
+        result->elapsed_ms = milliseconds_since(call_start);
+        return count;
+    }
+
+    // Stores the heap allocations of a frame since allocations_before, less those of its forward pass, for get_model_stats.
+    void record_frame_allocations(YOLOv8* model, const FrameWorkspace& workspace, unsigned long long allocations_before) {
+        if (!allocation_counting()) return;
+        std::lock_guard<std::mutex> lock(model->stats_mutex);
+        model->frame_allocations = static_cast<long long>(thread_allocation_count() - allocations_before - workspace.forward_allocations);
+    }
+
+    // Resizes the decoded image to the options' input size and detects in it, or takes the detections of a
+    // near-duplicate earlier upload. The time taken feeds the input size's latency estimate when the model ran, and
+    // its heap allocations are the ones frame_allocations reports.
+    bool detect_at_size(
+        YOLOv8* model, FrameWorkspace& workspace, const unsigned char* original_data, int width, int height,
+        const YOLOv8Options& options, std::vector<std::tuple<std::array<float, 4>, float, int>>& nms_boxes
+    ) {
+        auto start = std::chrono::steady_clock::now();
+        unsigned long long allocations_before = thread_allocation_count();
+        workspace.forward_allocations = 0;
+        int new_width = model_input_size(options);
+        uint64_t options_id = options_identity(options);
+        const unsigned char* resized_data = resize_to_input(workspace, original_data, width, height, new_width);
+        if (!resized_data) {
+            std::cerr << "Failed to resize the image\n";
+            return false;
+        }
+
+        std::cout << "Image resized." << std::endl;
+
+        // Re-encoded or resized copies of earlier uploads miss the exact cache but share a perceptual hash. Requests
+        // with other options keep apart by folding them into the model id.
+        uint64_t phash = 0;
+        uint64_t near_duplicate_model = model->model_id ^ options_id;
+        if (near_duplicate_cache().enabled()) {
+            phash = perceptual_hash(resized_data, new_width, workspace.thumbnail);
+            if (near_duplicate_cache().lookup(phash, near_duplicate_model, nms_boxes, workspace.search_stack)) {
+                std::cout << "Detections taken from a near-duplicate image." << std::endl;
+                record_frame_allocations(model, workspace, allocations_before);
+                return true;
+            }
+        }
+
+        bool skipped;
+        if (!detect(model, workspace, resized_data, options, options_id, nms_boxes, &skipped)) return false;
+        if (!skipped) record_size_latency(model, new_width, milliseconds_since(start));
+        if (near_duplicate_cache().enabled()) near_duplicate_cache().insert(phash, near_duplicate_model, nms_boxes);
+        record_frame_allocations(model, workspace, allocations_before);
+        return true;
+    }
+
+    void process_frame(YOLOv8* model, const char* frame_path, const char* output_path) {
+        process_frame_with_options(model, frame_path, output_path, nullptr, nullptr);
+    }
+
+    int process_frame_with_options(YOLOv8* model, const char* frame_path, const char* output_path, const YOLOv8Options* options, YOLOv8Result* result) {
+        auto call_start = std::chrono::steady_clock::now();
+        pin_calling_thread();
+        const YOLOv8Options& request = options ? *options : request_defaults();
+        uint64_t options_id = options_identity(request);
+
+        int width, height, channels;
+        if (!stbi_info(frame_path, &width, &height, &channels)) {
+            std::cerr << "Failed to read the image\n";
+            return -1;
+        }
+
+        // The resized input, the tensor and the detections all live in a workspace reused across calls.
+        WorkspaceLease workspace(model);
+        std::vector<std::tuple<std::array<float, 4>, float, int>>& nms_boxes = workspace->detections;
+
+        // Requests with a latency budget may run at a smaller input size, chosen once the time left is known. A size
+        // the backend fails at (a fixed-shape export) is not chosen again and the request reruns at the requested size.
+        YOLOv8Options effective = request;
+
+        // Oversized inputs are handled from the header alone, before anything the size of the frame is allocated.
+        unsigned long long max_pixels = model->max_pixels;
+        if (exceeds_pixel_budget(max_pixels, width, height)) {
+            if (model->oversize_policy == YOLO_OVERSIZE_REJECT) {
+                std::cerr << "Image " << width << "x" << height << " exceeds the pixel budget of " << max_pixels << ", rejected\n";
+                return -1;
+            }
+            effective.input_size = choose_input_size(model, request, milliseconds_since(call_start));
+            bool detected = process_frame_streaming(model, *workspace, frame_path, output_path, width, height, max_pixels, effective, nms_boxes);
+            if (!detected && model_input_size(effective) != model_input_size(request)) {
+                reject_input_size(model, model_input_size(effective));
+                effective = request;
+                detected = process_frame_streaming(model, *workspace, frame_path, output_path, width, height, max_pixels, effective, nms_boxes);
+            }
+            if (!detected) return -1;
+            return report_detections(*workspace, nms_boxes, width, height, model_input_size(effective), call_start, result);
+        }
+
+        // A re-upload of the same file skips inference, and decoding too when the annotated output was cached.
+        CacheLookup lookup;
+        if (answer_from_cache(model, frame_path, output_path, options_id, lookup)) {
+            return report_detections(*workspace, lookup.cached.detections, width, height, 0, call_start, result);
+        }
+        const std::vector<unsigned char>& encoded = lookup.encoded;
+
+        // Cached detections with nothing to draw need no pixels at all.
+        if (lookup.hit && !output_path) {
+            std::cout << "Detections taken from the result cache." << std::endl;
+            return report_detections(*workspace, lookup.cached.detections, width, height, 0, call_start, result);
+        }
+
+        unsigned char* original_data = encoded.empty()
+            ? stbi_load(frame_path, &width, &height, &channels, 3)
+            : stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &width, &height, &channels, 3);
+        if (!original_data) {
+            std::cerr << "Failed to read the image\n";
+            return -1;
+        }
+
+        std::cout << "Image loaded: " << width << "x" << height << " Channels: " << channels << std::endl;
+
+        int input_size = 0;
+        if (lookup.hit) {
+            nms_boxes = std::move(lookup.cached.detections);
+            std::cout << "Detections taken from the result cache." << std::endl;
+        } else {
+            effective.input_size = choose_input_size(model, request, milliseconds_since(call_start));
+            bool detected = detect_at_size(model, *workspace, original_data, width, height, effective, nms_boxes);
+            if (!detected && model_input_size(effective) != model_input_size(request)) {
+                reject_input_size(model, model_input_size(effective));
+                effective = request;
+                detected = detect_at_size(model, *workspace, original_data, width, height, effective, nms_boxes);
+            }
+            if (!detected) {
+                stbi_image_free(original_data);
+                return -1;
+            }
+            input_size = model_input_size(effective);
+
+            // Detections from a smaller input are cached under that size, not the requested one.
+            lookup.key.options = options_identity(effective);
+        }
+
+        if (output_path) {
+            // Draw straight onto the decoded frame rather than a copy of it
+            draw_rectangles(original_data, width, height, nms_boxes);
+            draw_labels(original_data, width, height, model->labels, nms_boxes);
+            std::cout << "Drawing rectangles done." << std::endl;
+        }
+
+        save_output(output_path, original_data, width, height, nms_boxes, &lookup);
+        stbi_image_free(original_data);
+        return report_detections(*workspace, nms_boxes, width, height, input_size, call_start, result);
+    }
+
+
+    void default_tile_options(YOLOv8TileOptions* options) {
+        options->overlap = 128;
+        options->batch_size = 4;
+    }
+
+    // Top-left corners along one axis so that `tile` sized windows, overlapping by at least `overlap`, cover [0, length).
+    std::vector<int> tile_origins(int length, int tile, int overlap) {
+        std::vector<int> origins;
+        int step = std::max(1, tile - overlap);
+        for (int origin = 0;; origin += step) {
+            if (origin + tile >= length) {
+                origins.push_back(std::max(0, length - tile));
+                break;
+            }
+            origins.push_back(origin);
+        }
+        return origins;
+    }
+
+    // Copies a tile x tile window at (x0, y0) into CHW float planes in [0, 1]. row_at(y) returns image row y, or
+    // nullptr past the bottom edge. Anything past the image edge is padded with grey (114), as in ultralytics'
+    // letterboxing, so small images and edge tiles keep their 1:1 scale.
+    void fill_tile(const std::function<const unsigned char*(int)>& row_at, int width, int x0, int y0, int tile, float* out) {
+        size_t plane = static_cast<size_t>(tile) * tile;
+        const float pad = 114.0f / 255.0f;
+        for (int y = 0; y < tile; ++y) {
+            const unsigned char* source = row_at(y0 + y);
+            float* r = out + static_cast<size_t>(y) * tile;
+            float* g = r + plane;
+            float* b = g + plane;
+            for (int x = 0; x < tile; ++x) {
+                int sx = x0 + x;
+                if (source && sx < width) {
+                    const unsigned char* pixel = source + static_cast<size_t>(sx) * 3;
+                    r[x] = pixel[0] / 255.0f;
+                    g[x] = pixel[1] / 255.0f;
+                    b[x] = pixel[2] / 255.0f;
+                } else {
+                    r[x] = g[x] = b[x] = pad;
+                }
+            }
+        }
+    }
+
+    // Runs the given tiles (top-left origins in image pixels) through the backend batch_size at a time. Each tile is
+    // decoded and NMS'd on its own and its detections are appended in image coordinates. batch_size drops to 1 if the
+    // backend rejects batches; once a single tile then runs, the handle remembers it (batch_rejected).
+    bool detect_tiles(
+        YOLOv8* model, const std::vector<std::pair<int, int>>& tiles,
+        const std::function<const unsigned char*(int)>& row_at, int width, int& batch_size,
+        std::vector<std::array<float, 4>>& boxes, std::vector<float>& scores, std::vector<int>& class_ids
+    ) {
+        const int tile = 640;
+        if (model->batch_rejected) batch_size = 1;
+        bool fell_back = false;
+        for (size_t first = 0; first < tiles.size();) {
+            int count = static_cast<int>(std::min<size_t>(batch_size, tiles.size() - first));
+            at::Tensor batch = torch::empty({count, 3, tile, tile}, torch::kFloat);
+            float* batch_data = batch.data_ptr<float>();
+            at::parallel_for(0, count, 1, [&](int64_t begin, int64_t end) {
+                for (int64_t i = begin; i < end; ++i) {
+                    const auto& origin = tiles[first + i];
+                    fill_tile(row_at, width, origin.first, origin.second, tile, batch_data + i * 3 * tile * tile);
+                }
+            });
+
+            at::Tensor output;
+            try {
+                auto forward_start = std::chrono::steady_clock::now();
+                output = model->backend->forward(batch);
+                record_forward_time(model, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - forward_start).count());
+            } catch (const std::exception& e) {
+                // Models exported with a fixed batch of 1 (or with in-graph NMS) reject larger batches; carry on one
+                // tile at a time. Anything else (out of memory, a broken model) fails the single tile too.
+                if (batch_size > 1) {
+                    std::cerr << "Batched forward failed (" << e.what() << "), retrying one tile per forward." << std::endl;
+                    batch_size = 1;
+                    fell_back = true;
+                    continue;
+                }
+                std::cerr << "Error during model inference: " << e.what() << std::endl;
+                return false;
+            }
+            if (fell_back && !model->batch_rejected) {
+                std::cout << "Single-tile forward works, this model runs tiles one at a time from now on." << std::endl;
+                model->batch_rejected = true;
+            }
+
+            std::vector<std::vector<std::tuple<std::array<float, 4>, float, int>>> tile_boxes(count);
+            at::parallel_for(0, count, 1, [&](int64_t begin, int64_t end) {
+                DecodeScratch scratch;
+                for (int64_t i = begin; i < end; ++i) {
+                    decode_output(model, output, i, request_defaults(), scratch, tile_boxes[i]);
+                }
+            });
+
+            for (int i = 0; i < count; ++i) {
+                const auto& origin = tiles[first + i];
+                for (const auto& box_info : tile_boxes[i]) {
+                    auto box = std::get<0>(box_info);
+                    boxes.push_back({box[0] + origin.first, box[1] + origin.second, box[2], box[3]});
+                    scores.push_back(std::get<1>(box_info));
+                    class_ids.push_back(std::get<2>(box_info));
+                }
+            }
+            first += count;
+        }
+        return true;
+    }
+
+    // Objects in the overlap between tiles are found more than once; keeps the best of each and converts the result to
+    // the model input coordinates (reference_size square over the whole image) that draw_rectangles/draw_labels work in.
+    std::vector<std::tuple<std::array<float, 4>, float, int>> merge_tile_detections(
+        const std::vector<std::array<float, 4>>& boxes, const std::vector<float>& scores, const std::vector<int>& class_ids,
+        int width, int height
+    ) {
+        // Every tile's candidates were already capped by decode_output; a large image can hold more than
+        // max_candidates real objects between its tiles, so the merge considers them all.
+        auto keep = apply_nms(boxes, scores, class_ids, 0.25, 0.45);
+
+        float to_model_x = static_cast<float>(reference_size) / width;
+        float to_model_y = static_cast<float>(reference_size) / height;
+        std::vector<std::tuple<std::array<float, 4>, float, int>> nms_boxes;
+        for (auto idx : keep) {
+            const auto& box = boxes[idx];
+            nms_boxes.emplace_back(std::array<float, 4>{box[0] * to_model_x, box[1] * to_model_y, box[2] * to_model_x, box[3] * to_model_y},
+                                   scores[idx], class_ids[idx]);
+        }
+        std::cout << "Tiled inference done: " << boxes.size() << " tile detections, " << nms_boxes.size() << " after merge." << std::endl;
+        return nms_boxes;
+    }
+
+    // Tiled inference over the pixel budget: rows are streamed into a ring holding the last 640 rows, and each band of
+    // tiles runs as soon as its bottom row has arrived. The annotated output is then written by decoding the file a
+    // second time and drawing onto one band of rows at a time, so neither pass holds the full frame.
+    void process_frame_tiled_streaming(YOLOv8* model, const char* frame_path, const char* output_path, const YOLOv8TileOptions* options) {
+        auto reader = open_row_reader(frame_path);
+        if (!reader) {
+            std::cerr << "Image exceeds the pixel budget and cannot be streamed (JPEG and non-interlaced PNG only)\n";
+            return;
+        }
+
+        const int tile = 640;
+        int width = reader->width();
+        int height = reader->height();
+        std::vector<int> band_origins = tile_origins(height, tile, options->overlap);
+        std::vector<int> column_origins = tile_origins(width, tile, options->overlap);
+        std::cout << "Streaming " << width << "x" << height << " in " << band_origins.size() << " bands of " << column_origins.size() << " tiles." << std::endl;
+
+        int ring_rows = std::min(tile, height);
+        size_t row_bytes = static_cast<size_t>(width) * 3;
+        std::vector<unsigned char> ring(ring_rows * row_bytes);
+        auto row_at = [&](int y) -> const unsigned char* {
+            return y < height ? ring.data() + (y % ring_rows) * row_bytes : nullptr;
+        };
+
+        std::vector<std::array<float, 4>> boxes;
+        std::vector<float> scores;
+        std::vector<int> class_ids;
+        int batch_size = std::max(1, options->batch_size);
+        size_t next_band = 0;
+
+        for (int y = 0; y < height; ++y) {
+            if (!reader->read_row(ring.data() + (y % ring_rows) * row_bytes)) {
+                std::cerr << "Failed to read the image\n";
+                return;
+            }
+            while (next_band < band_origins.size() && std::min(band_origins[next_band] + tile, height) - 1 == y) {
+                std::vector<std::pair<int, int>> tiles;
+                for (int x0 : column_origins) tiles.emplace_back(x0, band_origins[next_band]);
+                if (!detect_tiles(model, tiles, row_at, width, batch_size, boxes, scores, class_ids)) return;
+                ++next_band;
+            }
+        }
+        ring = std::vector<unsigned char>();
+
+        auto nms_boxes = merge_tile_detections(boxes, scores, class_ids, width, height);
+
+        reader = open_row_reader(frame_path);
+        JpegRowWriter writer;
+        if (!reader || !writer.open(output_path, width, height, 100)) {
+            std::cerr << "Failed to save the image\n";
+            return;
+        }
+
+        const int band_rows = 64;
+        std::vector<unsigned char> band(band_rows * row_bytes);
+        for (int band_top = 0; band_top < height; band_top += band_rows) {
+            int rows = std::min(band_rows, height - band_top);
+            for (int r = 0; r < rows; ++r) {
+                if (!reader->read_row(band.data() + r * row_bytes)) {
+                    std::cerr << "Failed to read the image\n";
+                    return;
+                }
+            }
+            draw_rectangles_band(band.data(), width, height, band_top, rows, nms_boxes);
+            draw_labels_band(band.data(), width, height, band_top, rows, model->labels, nms_boxes);
+            for (int r = 0; r < rows; ++r) {
+                if (!writer.write_row(band.data() + r * row_bytes)) {
+                    std::cerr << "Failed to save the image\n";
+                    return;
+                }
+            }
+        }
+
+        if (!writer.close()) {
+            std::cerr << "Failed to save the image\n";
+        } else {
+            std::cout << "Image saved to " << output_path << std::endl;
+        }
+    }
+
+    // Runs the model over overlapping full-resolution tiles instead of shrinking the whole image to 640x640, so small
+    // objects in very large images stay detectable. Tiles go through the backend `batch_size` at a time; each tile is
+    // decoded and NMS'd on its own, mapped back to image coordinates, and then merged with a global NMS pass.
+    void process_frame_tiled(YOLOv8* model, const char* frame_path, const char* output_path, const YOLOv8TileOptions* options) {
+        pin_calling_thread();
+        int width, height, channels;
+        if (!stbi_info(frame_path, &width, &height, &channels)) {
+            std::cerr << "Failed to read the image\n";
+            return;
+        }
+
+        // Over the pixel budget the image keeps its full detail but is streamed instead of decoded whole.
+        unsigned long long max_pixels = model->max_pixels;
+        if (exceeds_pixel_budget(max_pixels, width, height)) {
+            if (model->oversize_policy == YOLO_OVERSIZE_REJECT) {
+                std::cerr << "Image " << width << "x" << height << " exceeds the pixel budget of " << max_pixels << ", rejected\n";
+                return;
+            }
+            process_frame_tiled_streaming(model, frame_path, output_path, options);
+            return;
+        }
+
+        // Tiled results depend on the tile overlap, so it is part of the cache key.
+        const int tile = 640;
+        int tiling[3] = {1, tile, options->overlap};
+        CacheLookup lookup;
+        if (answer_from_cache(model, frame_path, output_path, hash64(tiling, sizeof(tiling)), lookup)) return;
+        const std::vector<unsigned char>& encoded = lookup.encoded;
+
+        unsigned char* original_data = encoded.empty()
+            ? stbi_load(frame_path, &width, &height, &channels, 3)
+            : stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &width, &height, &channels, 3);
+        if (!original_data) {
+            std::cerr << "Failed to read the image\n";
+            return;
+        }
+
+        std::vector<std::tuple<std::array<float, 4>, float, int>> nms_boxes;
+        if (lookup.hit) {
+            nms_boxes = std::move(lookup.cached.detections);
+            std::cout << "Detections taken from the result cache." << std::endl;
+        } else {
+            std::vector<std::pair<int, int>> tiles;
+            for (int y0 : tile_origins(height, tile, options->overlap)) {
+                for (int x0 : tile_origins(width, tile, options->overlap)) {
+                    tiles.emplace_back(x0, y0);
+                }
+            }
+            std::cout << "Image loaded: " << width << "x" << height << ", " << tiles.size() << " tiles." << std::endl;
+
+            auto row_at = [&](int y) -> const unsigned char* {
+                return y < height ? original_data + static_cast<size_t>(y) * width * 3 : nullptr;
+            };
+
+            std::vector<std::array<float, 4>> boxes;
+            std::vector<float> scores;
+            std::vector<int> class_ids;
+            int batch_size = std::max(1, options->batch_size);
+            if (!detect_tiles(model, tiles, row_at, width, batch_size, boxes, scores, class_ids)) {
+                stbi_image_free(original_data);
+                return;
+            }
+
+            nms_boxes = merge_tile_detections(boxes, scores, class_ids, width, height);
+        }
+
+        draw_rectangles(original_data, width, height, nms_boxes);
+        draw_labels(original_data, width, height, model->labels, nms_boxes);
+
+        save_output(output_path, original_data, width, height, nms_boxes, &lookup);
+        stbi_image_free(original_data);
+    }
+
+    void default_video_options(YOLOv8VideoOptions* options) {
+        options->frame_stride = 1;
+        options->ring_size = 4;
+        options->output_path = nullptr;
+        options->track = 0;
+        options->min_track_confidence = 0.0f;
+    }
+
+    // Replaces the detections with the tracker's active tracks (predicted boxes between detector runs).
+    void apply_tracks(const Tracker& tracker, int width, int height, std::vector<std::tuple<std::array<float, 4>, float, int>>& nms_boxes, std::vector<YOLOv8Detection>& detections) {
+        auto tracks = tracker.active_tracks();
+        nms_boxes.clear();
+        for (const Track* track : tracks) {
+            nms_boxes.emplace_back(track->box(), track->score, track->class_id);
+        }
+        to_frame_detections(nms_boxes, width, height, detections);
+        for (size_t i = 0; i < tracks.size(); ++i) {
+            detections[i].track_id = tracks[i]->id;
+        }
+    }
+
+    // Frames are decoded on a background thread into a small ring of preallocated buffers, already scaled to the model
+    // input, so decoding the next frames overlaps with inference on the current one and nothing touches the disk.
+    // With tracking, a Kalman-predicted track set carries detections across the frames the detector skips.
+    long long process_video(YOLOv8* model, const char* input_path, const YOLOv8VideoOptions* options, YOLOv8FrameCallback callback, void* user_data) {
+        pin_calling_thread();
+        int frame_stride = std::max(1, options->frame_stride);
+        bool annotate = options->output_path && *options->output_path;
+        bool track = options->track != 0;
+        // An adaptive detector run can fall on any frame, so every frame needs its model input.
+        bool adaptive = track && options->min_track_confidence > 0.0f;
+
+        VideoReader reader;
+        if (!reader.open(input_path, reference_size, reference_size, options->ring_size, adaptive ? 1 : frame_stride, annotate)) {
+            return -1;
+        }
+        int width = reader.width();
+        int height = reader.height();
+        std::cout << "Video opened: " << width << "x" << height << " at " << reader.frame_rate() << " fps" << std::endl;
+
+        VideoWriter writer;
+        if (annotate && !writer.open(options->output_path, width, height, reader.frame_rate())) {
+            return -1;
+        }
+
+        WorkspaceLease workspace(model);
+        std::vector<std::tuple<std::array<float, 4>, float, int>> nms_boxes;
+        std::vector<YOLOv8Detection> detections;
+        Tracker tracker;
+        long long frames = 0;
+        long long detector_runs = 0;
+        long long last_detection = 0;
+        while (VideoFrame* frame = reader.next()) {
+            if (track) tracker.predict();
+
+            bool run_detector = frame->index == 0 || frame->index - last_detection >= frame_stride ||
+                                (adaptive && tracker.min_confidence() < options->min_track_confidence);
+            if (run_detector && frame->has_model_input) {
+                if (!detect(model, *workspace, frame->model_input.data(), request_defaults(), 0, nms_boxes)) {
+                    reader.release(frame);
+                    return -1;
+                }
+                last_detection = frame->index;
+                ++detector_runs;
+                if (track) {
+                    tracker.update(nms_boxes);
+                } else {
+                    to_frame_detections(nms_boxes, width, height, detections);
+                }
+            }
+            if (track) apply_tracks(tracker, width, height, nms_boxes, detections);
+
+            if (callback) {
+                callback(user_data, frame->index, frame->timestamp_ms, detections.data(), static_cast<int>(detections.size()));
+            }
+            if (annotate) {
+                draw_rectangles_band(frame->rgb.data(), width, height, 0, height, nms_boxes);
+                draw_labels(frame->rgb.data(), width, height, model->labels, nms_boxes);
+                if (!writer.write(frame->rgb.data())) {
+                    reader.release(frame);
+                    std::cerr << "Failed to write the output video\n";
+                    return -1;
+                }
+            }
+            reader.release(frame);
+            ++frames;
+        }
+
+        if (reader.failed()) {
+            // A truncated output is not a result; the writer is dropped without its trailer like on any other failure.
+            std::cerr << "Video decoding failed after " << frames << " frames\n";
+            return -1;
+        }
+        std::cout << "Video processed: " << frames << " frames, " << detector_runs << " detector runs." << std::endl;
+        if (annotate) {
+            if (!writer.close()) {
+                std::cerr << "Failed to write the output video\n";
+                return -1;
+            }
+            std::cout << "Video saved to " << options->output_path << std::endl;
+        }
+        return frames;
+    }
+
+    int detect_batch(YOLOv8* model, const unsigned char* const* inputs, const int* widths, const int* heights, int count, YOLOv8BatchCallback callback, void* user_data) {
+        pin_calling_thread();
+        const int size = reference_size;
+        const size_t plane = static_cast<size_t>(size) * size;
+        int batch_size = model->batch_rejected ? 1 : std::max(1, count);
+        bool fell_back = false;
+        std::vector<YOLOv8Detection> detections;
+        for (int first = 0; first < count;) {
+            int n = std::min(batch_size, count - first);
+            at::Tensor batch = torch::empty({n, 3, size, size}, torch::kFloat);
+            float* batch_data = batch.data_ptr<float>();
+            at::parallel_for(0, n, 1, [&](int64_t begin, int64_t end) {
+                for (int64_t i = begin; i < end; ++i) {
+                    to_planar(inputs[first + i], plane, batch_data + i * 3 * plane);
+                }
+            });
+
+            at::Tensor output;
+            try {
+                auto forward_start = std::chrono::steady_clock::now();
+                output = model->backend->forward(batch);
+                record_forward_time(model, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - forward_start).count());
+            } catch (const std::exception& e) {
+                if (batch_size > 1) {
+                    std::cerr << "Batched forward failed (" << e.what() << "), retrying one image per forward." << std::endl;
+                    batch_size = 1;
+                    fell_back = true;
+                    continue;
+                }
+                std::cerr << "Error during model inference: " << e.what() << std::endl;
+                return 0;
+            }
+            if (fell_back && !model->batch_rejected) {
+                std::cout << "Single-image forward works, this model runs images one at a time from now on." << std::endl;
+                model->batch_rejected = true;
+            }
+
+            std::vector<std::vector<std::tuple<std::array<float, 4>, float, int>>> image_boxes(n);
+            at::parallel_for(0, n, 1, [&](int64_t begin, int64_t end) {
+                DecodeScratch scratch;
+                for (int64_t i = begin; i < end; ++i) {
+                    decode_output(model, output, i, request_defaults(), scratch, image_boxes[i]);
+                }
+            });
+
+            for (int i = 0; i < n; ++i) {
+                to_frame_detections(image_boxes[i], widths[first + i], heights[first + i], detections);
+                if (callback) callback(user_data, first + i, detections.data(), static_cast<int>(detections.size()));
+            }
+            first += n;
+        }
+        return 1;
+    }
+
+    void draw_detections(YOLOv8* model, unsigned char* image_data, int width, int height, const YOLOv8Detection* detections, int count) {
+        // The drawing helpers work in model input coordinates.
+        float to_model_x = static_cast<float>(reference_size) / width;
+        float to_model_y = static_cast<float>(reference_size) / height;
+        std::vector<std::tuple<std::array<float, 4>, float, int>> nms_boxes;
+        for (int i = 0; i < count; ++i) {
+            const YOLOv8Detection& d = detections[i];
+            nms_boxes.emplace_back(std::array<float, 4>{d.x * to_model_x, d.y * to_model_y, d.width * to_model_x, d.height * to_model_y},
+                                   d.score, d.class_id);
+        }
+        draw_rectangles_band(image_data, width, height, 0, height, nms_boxes);
+        draw_labels(image_data, width, height, model->labels, nms_boxes);
+    }
+
+    int get_model_precision(YOLOv8* model) {
+        return model->precision;
+    }
 
     void release_model(YOLOv8* model) {
         delete model;
     }
+
+    // One copy of a registered model. A replica placed on a NUMA node runs its requests on worker threads bound to
+    // that node, so the weights and workspaces they first touch and the intra-op threads they start stay on the node.
+    // Without a node (-1) requests run on the calling thread.
+    struct ModelReplica {
+        std::shared_ptr<YOLOv8> model;
+        int node = -1;
+        std::atomic<int> in_flight{0};          // Requests queued or running, for least-loaded dispatch
+        std::atomic<int> intra_op_threads{0};   // Of each worker, set once they start
+
+        std::mutex mutex;
+        std::condition_variable job_ready;
+        std::deque<std::function<void()>> jobs;
+        bool stopping = false;
+        std::vector<std::thread> workers;
+
+        ModelReplica(int node, int worker_count) : node(node) {
+            for (int i = 0; i < worker_count; ++i) workers.emplace_back([this, worker_count] { work(worker_count); });
+        }
+
+        ~ModelReplica() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            job_ready.notify_all();
+            for (auto& worker : workers) worker.join();
+        }
+
+        void work(int worker_count) {
+            bound_to_node = bind_thread_to_node(node);
+            if (!bound_to_node) std::cerr << "Failed to bind a worker to NUMA node " << node << std::endl;
+
+            // The workers share their node's CPUs, so each forward gets a share of them rather than a team sized to the
+            // whole machine. libtorch sets a thread's OpenMP team to the process-wide count on its first parallel op,
+            // so that is done first, and the worker's own count then only goes to OpenMP's per-thread setting; nodes
+            // can have different CPU counts and at::set_num_threads would change the process-wide one. libtorch builds
+            // with its native thread pool have one pool for the process and the workers use it as it is.
+            at::init_num_threads();
+#ifdef _OPENMP
+            int threads = std::max(1, static_cast<int>(thread_cpus().size()) / worker_count);
+            omp_set_num_threads(threads);
+            intra_op_threads = threads;
+#else
+            intra_op_threads = at::get_num_threads();
+#endif
+            for (;;) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    job_ready.wait(lock, [this] { return stopping || !jobs.empty(); });
+                    if (jobs.empty()) return;
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                job();
+            }
+        }
+
+        // Runs job on one of the workers, or on the calling thread when there are none, and waits for it.
+        void run(const std::function<void()>& job) {
+            if (workers.empty()) {
+                job();
+                return;
+            }
+            std::packaged_task<void()> task(job);
+            std::future<void> done = task.get_future();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobs.emplace_back([&task] { task(); });
+            }
+            job_ready.notify_one();
+            done.get();
+        }
+    };
+
+    // A registered name: a single replica, or one per NUMA node (YOLOv8LoadOptions::numa_replicas).
+    struct RegisteredModel {
+        std::vector<std::unique_ptr<ModelReplica>> replicas;
+
+        ModelReplica& least_loaded() {
+            ModelReplica* best = replicas.front().get();
+            for (const auto& replica : replicas) {
+                if (replica->in_flight < best->in_flight) best = replica.get();
+            }
+            return *best;
+        }
+    };
+
+    // Models registered by name. Requests take their own reference, so unregistering or replacing a model never frees
+    // it under a running request.
+    struct ModelRegistry {
+        std::mutex mutex;
+        std::map<std::string, std::shared_ptr<RegisteredModel>> models;
+        std::map<std::string, int> reloads;     // YOLOv8ReloadState of the latest reload_model call per name
+        // Handles given out by acquire_model/acquire_replica with the entry each keeps alive and its acquire count.
+        std::map<YOLOv8*, std::pair<std::shared_ptr<RegisteredModel>, int>> acquired;
+    };
+
+    // Never destroyed, so a reload still loading at exit does not touch a destroyed registry.
+    ModelRegistry& model_registry() {
+        static ModelRegistry* registry = new ModelRegistry;
+        return *registry;
+    }
+
+    std::shared_ptr<RegisteredModel> registered_model(const char* name) {
+        ModelRegistry& registry = model_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.models.find(name);
+        return it == registry.models.end() ? nullptr : it->second;
+    }
+
+    // Swaps model in under name. Calls already running keep their reference to the previous model, which is released
+    // when the last of them finishes (outside the lock, since that joins its replica workers).
+    void publish_model(const std::string& name, std::shared_ptr<RegisteredModel> model) {
+        ModelRegistry& registry = model_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.models[name].swap(model);
+    }
+
+    // publish_model only while name still maps to expected (nullptr: is still unregistered), so a reload that finishes
+    // after the name was unregistered or registered again does not undo that.
+    bool publish_model_if(const std::string& name, const std::shared_ptr<RegisteredModel>& expected, std::shared_ptr<RegisteredModel> model) {
+        ModelRegistry& registry = model_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.models.find(name);
+        std::shared_ptr<RegisteredModel> current = it == registry.models.end() ? nullptr : it->second;
+        if (current != expected) return false;
+        registry.models[name].swap(model);
+        return true;
+    }
+
+    // Runs one forward pass on a blank input so the lazy initialisation of the first frame (see first_forward_ms) is
+    // over before the model takes requests. The workspace it grows is kept for them.
+    bool warm_up(YOLOv8* model) {
+        WorkspaceLease workspace(model);
+        std::vector<unsigned char> blank(static_cast<size_t>(reference_size) * reference_size * 3, 114);
+        return detect(model, *workspace, blank.data(), request_defaults(), 0, workspace->detections);
+    }
+
+    // Loads a model for the registry: once, or with numa_replicas once per NUMA node on that node's workers, all nodes
+    // at the same time. Node replicas are always warmed up so their workspaces are allocated on the node too. Returns
+    // nullptr when any copy fails.
+    std::shared_ptr<RegisteredModel> load_replicas(const char* model_path, const YOLOv8LoadOptions* options, bool warm) {
+        auto entry = std::make_shared<RegisteredModel>();
+        std::vector<int> nodes;
+        if (options->numa_replicas) {
+            nodes = numa_nodes();
+            if (nodes.size() < 2) {
+                std::cout << "No second NUMA node (or built without libnuma), loading a single replica." << std::endl;
+                nodes.clear();
+            }
+        }
+
+        if (nodes.empty()) {
+            auto replica = std::make_unique<ModelReplica>(-1, 0);
+            replica->model.reset(load_model_with_options(model_path, options), release_model);
+            if (!replica->model || (warm && !warm_up(replica->model.get()))) return nullptr;
+            entry->replicas.push_back(std::move(replica));
+            return entry;
+        }
+
+        for (int node : nodes) entry->replicas.push_back(std::make_unique<ModelReplica>(node, std::max(1, options->concurrency)));
+        std::atomic<bool> failed{false};
+        std::vector<std::thread> loaders;
+        for (const auto& replica : entry->replicas) {
+            ModelReplica* target = replica.get();
+            loaders.emplace_back([target, model_path, options, &failed] {
+                target->run([target, model_path, options, &failed] {
+                    target->model.reset(load_model_with_options(model_path, options), release_model);
+                    if (!target->model || !warm_up(target->model.get())) failed = true;
+                });
+            });
+        }
+        for (auto& loader : loaders) loader.join();
+        if (failed) return nullptr;
+
+        std::cout << "Loaded " << nodes.size() << " replicas, one per NUMA node." << std::endl;
+        return entry;
+    }
+
+    int register_model(const char* name, const char* model_path, const YOLOv8LoadOptions* options) {
+        YOLOv8LoadOptions defaults;
+        if (!options) {
+            default_load_options(&defaults);
+            options = &defaults;
+        }
+
+        // Loaded outside the lock so other names keep serving meanwhile.
+        std::shared_ptr<RegisteredModel> model = load_replicas(model_path, options, false);
+        if (!model) return 0;
+
+        publish_model(name, std::move(model));
+        std::cout << "Model " << name << " registered from " << model_path << std::endl;
+        return 1;
+    }
+
+    // Carries the per-handle settings over to a reloaded model. The motion gate starts a new background.
+    void copy_settings(YOLOv8* from, YOLOv8* to) {
+        to->max_pixels = from->max_pixels.load();
+        to->oversize_policy = from->oversize_policy.load();
+        to->max_candidates = from->max_candidates.load();
+
+        float threshold;
+        {
+            std::lock_guard<std::mutex> lock(from->motion_mutex);
+            threshold = from->motion_gate.threshold();
+        }
+        set_motion_gate(to, threshold);
+    }
+
+    void set_reload_state(const std::string& name, int state) {
+        ModelRegistry& registry = model_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.reloads[name] = state;
+    }
+
+    int reload_model(const char* name, const char* model_path, const YOLOv8LoadOptions* options) {
+        YOLOv8LoadOptions load_options;
+        if (options) load_options = *options;
+        else default_load_options(&load_options);
+
+        std::string model_name = name;
+        std::shared_ptr<RegisteredModel> replaced;      // The entry the reload replaces, see publish_model_if
+        {
+            ModelRegistry& registry = model_registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            int& state = registry.reloads[model_name];
+            if (state == YOLO_RELOAD_PENDING) return 0;
+            state = YOLO_RELOAD_PENDING;
+            auto it = registry.models.find(model_name);
+            if (it != registry.models.end()) replaced = it->second;
+        }
+
+        // Loading and warming up take seconds, so they run on their own thread while the current model keeps serving.
+        std::thread([model_name, path = std::string(model_path), load_options, replaced]() mutable {
+            std::shared_ptr<RegisteredModel> model = load_replicas(path.c_str(), &load_options, true);
+            if (!model) {
+                std::cerr << "Reload of " << model_name << " from " << path << " failed, keeping the current model" << std::endl;
+                set_reload_state(model_name, YOLO_RELOAD_FAILED);
+                return;
+            }
+
+            if (replaced) {
+                for (const auto& replica : model->replicas) copy_settings(replaced->replicas.front()->model.get(), replica->model.get());
+            }
+
+            if (!publish_model_if(model_name, replaced, std::move(model))) {
+                std::cerr << "Reload of " << model_name << " dropped, the name was unregistered or registered again meanwhile" << std::endl;
+                set_reload_state(model_name, YOLO_RELOAD_SUPERSEDED);
+                return;
+            }
+            replaced.reset();
+            set_reload_state(model_name, YOLO_RELOAD_DONE);
+            std::cout << "Model " << model_name << " reloaded from " << path << std::endl;
+        }).detach();
+        return 1;
+    }
+
+    void default_thread_options(YOLOv8ThreadOptions* options) {
+        options->intra_op_threads = 0;
+        options->inter_op_threads = 0;
+        options->inference_cpus = nullptr;
+        options->inference_cpu_count = 0;
+        options->processing_cpus = nullptr;
+        options->processing_cpu_count = 0;
+    }
+
+    int set_thread_options(const YOLOv8ThreadOptions* options) {
+        ThreadConfig& config = thread_config();
+        std::vector<int> inference_set, pool_cpus;
+        if (options->inference_cpus && options->inference_cpu_count > 0) {
+            inference_set.assign(options->inference_cpus, options->inference_cpus + options->inference_cpu_count);
+        }
+        {
+            std::lock_guard<std::mutex> lock(config.mutex);
+            if (config.initial_cpus.empty()) config.initial_cpus = thread_cpus();
+            config.intra_op_threads = std::max(0, options->intra_op_threads);
+            config.inter_op_threads = std::max(0, options->inter_op_threads);
+            config.inference_cpus = inference_set;
+            config.processing_cpus.clear();
+            if (options->processing_cpus && options->processing_cpu_count > 0) {
+                config.processing_cpus.assign(options->processing_cpus, options->processing_cpus + options->processing_cpu_count);
+            }
+            pool_cpus = inference_set.empty() ? config.initial_cpus : inference_set;
+        }
+
+        bool applied = true;
+        // libtorch fixes the inter-op pool's size the first time it is used.
+        if (options->inter_op_threads > 0) {
+            try {
+                at::set_num_interop_threads(options->inter_op_threads);
+            } catch (const std::exception&) {
+                std::cerr << "Inter-op threads already started, keeping " << at::get_num_interop_threads() << std::endl;
+                applied = false;
+            }
+        }
+        if (options->intra_op_threads > 0) at::set_num_threads(options->intra_op_threads);
+
+        // One chunk per intra-op thread, each pinning the thread that runs it. Threads the pool starts here, or later
+        // from this thread's set, inherit the inference CPUs too.
+        {
+            ScopedAffinity caller_affinity(pool_cpus);
+            at::parallel_for(0, at::get_num_threads(), 1, [&pool_cpus](int64_t, int64_t) {
+                pin_thread(pool_cpus);
+            });
+        }
+
+#ifdef YOLO_WITH_ONNXRUNTIME
+        if (onnxruntime_started && (options->intra_op_threads > 0 || options->inter_op_threads > 0 || !inference_set.empty())) {
+            std::cerr << "ONNX Runtime's thread pools already started with the first ONNX model, thread options apply to them after a restart" << std::endl;
+            applied = false;
+        }
+#endif
+#ifdef YOLO_WITH_OPENVINO
+        if (options->intra_op_threads > 0) {
+            openvino_core().set_property("CPU", ov::inference_num_threads(options->intra_op_threads));
+        }
+#endif
+
+        ++config.generation;
+        pin_calling_thread();
+        return applied ? 1 : 0;
+    }
+
+    void get_thread_info(YOLOv8ThreadInfo* info) {
+        ThreadConfig& config = thread_config();
+        std::lock_guard<std::mutex> lock(config.mutex);
+        info->intra_op_threads = at::get_num_threads();
+        info->inter_op_threads = at::get_num_interop_threads();
+        info->available_cpus = static_cast<int>((config.initial_cpus.empty() ? thread_cpus() : config.initial_cpus).size());
+        info->inference_cpu_count = static_cast<int>(config.inference_cpus.size());
+        info->processing_cpu_count = static_cast<int>(config.processing_cpus.size());
+    }
+
+    int get_reload_state(const char* name) {
+        ModelRegistry& registry = model_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.reloads.find(name);
+        return it == registry.reloads.end() ? YOLO_RELOAD_NONE : it->second;
+    }
+
+    // The entry is released after the lock, like in publish_model, since the last reference joins its replica workers.
+    int unregister_model(const char* name) {
+        std::shared_ptr<RegisteredModel> removed;
+        {
+            ModelRegistry& registry = model_registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            auto it = registry.models.find(name);
+            if (it == registry.models.end()) return 0;
+            removed = std::move(it->second);
+            registry.models.erase(it);
+        }
+        return 1;
+    }
+
+    YOLOv8* acquire_model(const char* name) {
+        return acquire_replica(name, 0);
+    }
+
+    int get_replica_count(const char* name) {
+        std::shared_ptr<RegisteredModel> model = registered_model(name);
+        return model ? static_cast<int>(model->replicas.size()) : 0;
+    }
+
+    int get_replica_threads(const char* name, int index) {
+        std::shared_ptr<RegisteredModel> model = registered_model(name);
+        if (!model || index < 0 || index >= static_cast<int>(model->replicas.size())) return 0;
+        return model->replicas[index]->intra_op_threads;
+    }
+
+    YOLOv8* acquire_replica(const char* name, int index) {
+        ModelRegistry& registry = model_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.models.find(name);
+        if (it == registry.models.end() || index < 0 || index >= static_cast<int>(it->second->replicas.size())) return nullptr;
+
+        YOLOv8* handle = it->second->replicas[index]->model.get();
+        auto& reference = registry.acquired[handle];
+        reference.first = it->second;
+        ++reference.second;
+        return handle;
+    }
+
+    void release_acquired_model(YOLOv8* model) {
+        std::shared_ptr<RegisteredModel> released;
+        {
+            ModelRegistry& registry = model_registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            auto it = registry.acquired.find(model);
+            if (it == registry.acquired.end()) return;
+            if (--it->second.second > 0) return;
+            released = std::move(it->second.first);
+            registry.acquired.erase(it);
+        }
+        // A model no longer registered is freed here, outside the lock.
+    }
+
+    int process_frame_named(const char* name, const char* frame_path, const char* output_path, const YOLOv8Options* options, YOLOv8Result* result) {
+        std::shared_ptr<RegisteredModel> model = registered_model(name);
+        if (!model) {
+            std::cerr << "No model registered as " << name << std::endl;
+            return -1;
+        }
+
+        ModelReplica& replica = model->least_loaded();
+        ++replica.in_flight;
+        int count = -1;
+        replica.run([&] {
+            count = process_frame_with_options(replica.model.get(), frame_path, output_path, options, result);
+        });
+        --replica.in_flight;
+        return count;
+    }
+
+    int get_named_model_stats(const char* name, YOLOv8Stats* stats) {
+        std::shared_ptr<RegisteredModel> model = registered_model(name);
+        if (!model) return 0;
+
+        // Replicas are summed; latencies are the slowest load and first forward, and the mean over every replica's frames.
+        *stats = YOLOv8Stats{};
+        stats->frame_allocations = -1;
+        double total_forward_ms = 0.0;
+        unsigned long long steady_frames = 0;
+        for (const auto& replica : model->replicas) {
+            YOLOv8Stats replica_stats;
+            get_model_stats(replica->model.get(), &replica_stats);
+            unsigned long long replica_steady = replica_stats.frames > 1 ? replica_stats.frames - 1 : 0;
+            total_forward_ms += replica_stats.mean_forward_ms * replica_steady;
+            steady_frames += replica_steady;
+            stats->load_ms = std::max(stats->load_ms, replica_stats.load_ms);
+            stats->first_forward_ms = std::max(stats->first_forward_ms, replica_stats.first_forward_ms);
+            stats->frames += replica_stats.frames;
+            stats->skipped_frames += replica_stats.skipped_frames;
+            stats->frame_allocations = std::max(stats->frame_allocations, replica_stats.frame_allocations);
+            stats->weight_bytes += replica_stats.weight_bytes;
+            stats->workspace_bytes += replica_stats.workspace_bytes;
+        }
+        stats->mean_forward_ms = steady_frames ? total_forward_ms / steady_frames : 0.0;
+        return 1;
+    }
 }
\ No newline at end of file